@@ -3,7 +3,27 @@
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <string>
+#include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
 #include <SFML/Graphics.hpp>
+#include "../fixed_timestep.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HW01_SIMD_X86
+#include <immintrin.h>
+#endif
 
 namespace utility {
     // in case the person compiling this does not have C++17 installed
@@ -19,7 +39,9 @@ namespace utility {
 // constants
 constexpr unsigned int fps_limit{60};
 constexpr float epsilon{1e-6f};
-const sf::Time fixed_update_time = sf::seconds(1.f/144.f);
+// the iterative contact solver keeps dense packs stable at the display rate
+const sf::Time fixed_update_time = sf::seconds(1.f/60.f);
+constexpr unsigned int max_substeps{16};
 const sf::Vector2f zero_vector{0.f,0.f};
 constexpr float pi{std::acos(-1)};
 constexpr float deg_to_rad{pi/180.f};
@@ -37,6 +59,9 @@ namespace default_vals {
         constexpr float friction{0.05f};
     }
     constexpr unsigned int num_circles{8};
+    constexpr unsigned int solver_threads{0}; // 0 uses every hardware thread
+    constexpr unsigned int solver_iterations{8};
+    constexpr float sleep_time{1.f}; // seconds an island has to stay quiet before it sleeps; 0 never sleeps
     namespace enemy {
         constexpr float radius{30.f};
         constexpr float mass{500.f};
@@ -49,8 +74,13 @@ struct Material {
     float mass{100.f};
     float elasticity{0.f};
     float friction{0.01f};
+    sf::Color colorNoFriction{sf::Color::Green};
+    sf::Color colorFriction{sf::Color::Red};
 };
 
+constexpr unsigned int user_material_id{0};
+constexpr unsigned int enemy_material_id{1};
+
 template <typename T>
 T dot (const sf::Vector2<T>& a, const sf::Vector2<T>& b) {
     return a.x*b.x + a.y*b.y;
@@ -61,130 +91,272 @@ T cross (const sf::Vector2<T>& a, const sf::Vector2<T>& b) {
     return a.x*b.y - b.x*a.y;
 }
 
-struct BallEntity {
-    sf::CircleShape ball;
-    Material material;
-    float radius;
-    sf::Vector2f velocity;
-    sf::Color colorNoFriction{sf::Color::Green};
-    sf::Color colorFriction{sf::Color::Red};
+// structure-of-arrays ball store; this is what the physics runs on
+// index 0 is always the user ball, the enemies follow it
+// the drawables are only refreshed from here once per rendered frame
+struct BallStore {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> vx;
+    std::vector<float> vy;
+    std::vector<float> invMass; // 0 means immovable
+    std::vector<float> radius;
+    std::vector<unsigned int> material;
+    std::vector<float> quietTime;       // how long the ball has been slower than sleep_speed
+    std::vector<unsigned char> asleep;  // sleeping balls are neither integrated nor pair-tested against each other
 
-    BallEntity() = default;
+    unsigned int size() const {
+        return x.size();
+    }
 
-    void setFrictionColors(const sf::Color& cNF, const sf::Color& cF) {
-        colorNoFriction = cNF;
-        colorFriction = cF;
+    void resize(unsigned int n) {
+        x.resize(n);
+        y.resize(n);
+        vx.resize(n);
+        vy.resize(n);
+        invMass.resize(n);
+        radius.resize(n);
+        material.resize(n);
+        quietTime.resize(n);
+        asleep.resize(n);
     }
 
-    void initializeEntity(float x, float y, bool frictionEnabled = false) {
-        ball.setOrigin(radius,radius);
-        ball.setRadius(radius);
-        ball.setPosition(x, y);
-        ball.setFillColor(frictionEnabled ? colorFriction : colorNoFriction);
+    void initializeBall(unsigned int i, float px, float py, float r, unsigned int materialId, const Material& m) {
+        x[i] = px;
+        y[i] = py;
+        vx[i] = vy[i] = 0.f;
+        invMass[i] = std::fabs(m.mass) > epsilon ? 1.f / m.mass : 0.f;
+        radius[i] = r;
+        material[i] = materialId;
+        quietTime[i] = 0.f;
+        asleep[i] = 0;
     }
+};
 
-    void moveEntity(const sf::Vector2f& acceleration, float delta, bool frictionEnabled = false) {
-        sf::Vector2f nVelocity = velocity;
-        sf::Vector2f pos = ball.getPosition();
-        pos += acceleration * 0.5f * delta * delta + nVelocity * delta;
-        nVelocity += acceleration * delta;
-        ball.setPosition(pos);
+// uniform grid broadphase; balls are bucketed by center with a counting sort every fixed step
+// cells are sized from the enemy diameter so an enemy only ever has to look at the 3x3 cells around it
+struct SpatialGrid {
+    float cellSize{1.f};
+    float invCellSize{1.f};
+    int cols{1};
+    int rows{1};
+    std::vector<unsigned int> cellStart;   // cellEntries[cellStart[c] .. cellStart[c+1]) are the balls in cell c
+    std::vector<unsigned int> cellEntries;
+    std::vector<unsigned int> ballCell;
 
-        float nVMag = std::hypot(nVelocity.x, nVelocity.y);
-        if (frictionEnabled) {
-            ball.setFillColor(colorFriction);
-            if (std::fabs(nVMag) > epsilon) {
-                sf::Vector2f nVNorm = nVelocity / nVMag;
-                nVMag = std::max(0.f, nVMag - material.friction * delta);
-                nVelocity = nVNorm * nVMag;
-            }
-        } else {
-            ball.setFillColor(colorNoFriction);
-        }
+    void configure(float size, float x_bound, float y_bound) {
+        cellSize = std::max(size, 1.f);
+        invCellSize = 1.f / cellSize;
+        cols = std::max(1, static_cast<int>(std::ceil(x_bound * invCellSize)));
+        rows = std::max(1, static_cast<int>(std::ceil(y_bound * invCellSize)));
+        cellStart.assign(cols * rows + 1, 0);
+    }
 
-        if (std::fabs(nVMag) > epsilon) {
-            velocity = nVelocity;
-        } else {
-            velocity = zero_vector;
-        }
+    int cellX(float x) const {
+        return utility::clamp(static_cast<int>(std::floor(x * invCellSize)), 0, cols - 1);
     }
 
-    // this WILL change the other entity
-    // if you don't like this, do another kind of collision resolution
-    bool collisionWith(BallEntity& other) {
-        sf::Vector2f this_entity = ball.getPosition();
-        sf::Vector2f other_entity = other.ball.getPosition();
+    int cellY(float y) const {
+        return utility::clamp(static_cast<int>(std::floor(y * invCellSize)), 0, rows - 1);
+    }
 
-        sf::Vector2f difference_vector = other_entity - this_entity; // negate if other way
-        float dist = std::hypot(difference_vector.x, difference_vector.y);
-        float interpenetration_dist = (radius + other.radius) - dist;
+    void rebuild(const BallStore& balls) {
+        unsigned int n = balls.size();
+        ballCell.resize(n);
+        cellEntries.resize(n);
+        std::fill(cellStart.begin(), cellStart.end(), 0);
 
-        sf::Vector2f collision_normal;
-        if (std::fabs(dist) > epsilon) {
-            collision_normal = difference_vector / dist;
+        for (unsigned int i = 0; i < n; ++i) {
+            ballCell[i] = cellY(balls.y[i]) * cols + cellX(balls.x[i]);
+            cellStart[ballCell[i]]++;
         }
+        // inclusive prefix sum: cellStart[c] is now one past the end of cell c
+        for (unsigned int c = 1; c < cellStart.size(); ++c) {
+            cellStart[c] += cellStart[c - 1];
+        }
+        // fill back to front so every cell keeps its balls in ascending index order
+        // and cellStart[c] ends up at the start of cell c
+        for (unsigned int i = n; i-- > 0;) {
+            cellEntries[--cellStart[ballCell[i]]] = i;
+        }
+    }
 
-        if (interpenetration_dist > epsilon) { // touching
-            // resolve interpenetration
-            ball.move(-collision_normal * interpenetration_dist);
-
-            sf::Vector2f vAB = velocity - other.velocity;
-            sf::Vector2f vBA = -vAB;
+    // calls fn(j) for every ball whose cell touches the square of half-size reach around (x, y)
+    template <typename F>
+    void forEachNear(float x, float y, float reach, F&& fn) const {
+        int x0 = cellX(x - reach), x1 = cellX(x + reach);
+        int y0 = cellY(y - reach), y1 = cellY(y + reach);
+        for (int cy = y0; cy <= y1; ++cy) {
+            for (int cx = x0; cx <= x1; ++cx) {
+                int c = cy * cols + cx;
+                for (unsigned int k = cellStart[c]; k < cellStart[c + 1]; ++k) {
+                    fn(cellEntries[k]);
+                }
+            }
+        }
+    }
+};
 
-            float sum_massriprocals = 1.f/material.mass + 1.f/other.material.mass;
+// every ball is one textured square in a single vertex array, so the whole world is one draw call
+// the texture is a white anti-aliased disc and the square's vertex colors tint it
+// the square is two triangles rather than an sf::Quads quad, which is deprecated and not drawable on core GL contexts
+constexpr unsigned int circle_texture_size{128};
+constexpr unsigned int vertices_per_ball{6};
 
-            // note: the "elasticity" is also known as the coefficient of restitution
-            // different physics engines may choose to modify this depending on the situation
-            float this_impulse = -(((1 + material.elasticity) * dot(vAB, collision_normal)) / sum_massriprocals);
-            float other_impulse = -(((1 + other.material.elasticity) * dot(vBA, collision_normal)) / sum_massriprocals);
+struct BallBatch {
+    sf::Texture circleTexture;
+    sf::VertexArray triangles{sf::Triangles};
+    bool colorsFriction{false};
+    bool colorsValid{false};
 
-            sf::Vector2f this_new_velocity;
-            if (std::fabs(material.mass) > epsilon) {
-                this_new_velocity = velocity + collision_normal * (this_impulse / material.mass);
+    void initializeTexture() {
+        sf::Image image;
+        image.create(circle_texture_size, circle_texture_size, sf::Color::Transparent);
+        float center = circle_texture_size / 2.f;
+        for (unsigned int py = 0; py < circle_texture_size; ++py) {
+            for (unsigned int px = 0; px < circle_texture_size; ++px) {
+                float d = std::hypot(px + 0.5f - center, py + 0.5f - center);
+                float coverage = utility::clamp(center - d, 0.f, 1.f);
+                image.setPixel(px, py, sf::Color(255, 255, 255, static_cast<sf::Uint8>(coverage * 255.f)));
             }
+        }
+        circleTexture.loadFromImage(image);
+        circleTexture.setSmooth(true);
+    }
 
-            sf::Vector2f other_new_velocity;
-            if (std::fabs(other.material.mass) > epsilon) {
-                other_new_velocity = other.velocity + collision_normal * (other_impulse / other.material.mass);
-            }
+    void resize(unsigned int count) {
+        triangles.resize(count * vertices_per_ball);
+        float size = static_cast<float>(circle_texture_size);
+        for (unsigned int i = 0; i < count; ++i) {
+            // top-left, top-right, bottom-right and top-left, bottom-right, bottom-left
+            sf::Vertex* square = &triangles[i * vertices_per_ball];
+            square[0].texCoords = square[3].texCoords = sf::Vector2f(0.f, 0.f);
+            square[1].texCoords = sf::Vector2f(size, 0.f);
+            square[2].texCoords = square[4].texCoords = sf::Vector2f(size, size);
+            square[5].texCoords = sf::Vector2f(0.f, size);
+        }
+        colorsValid = false;
+    }
 
-            velocity = this_new_velocity;
-            other.velocity = other_new_velocity;
-            return true;
-        } else {
-            return false;
+    void draw(sf::RenderTarget& target) const {
+        target.draw(triangles, &circleTexture);
+    }
+};
+
+// persistent pool of worker threads; the calling thread takes the first slice of every job
+// slices are fixed by thread index, so the same job always splits the same way
+struct WorkerPool {
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(unsigned int, unsigned int)> job;
+    unsigned int jobSize{0};
+    unsigned int generation{0};
+    unsigned int pending{0};
+    bool quit{false};
+
+    unsigned int threadCount() const {
+        return workers.size() + 1;
+    }
+
+    void start(unsigned int count) {
+        stop();
+        for (unsigned int t = 1; t < count; ++t) {
+            workers.emplace_back([this, t]() { workerLoop(t); });
         }
     }
 
-    // snapping; can't think of a better way
-    void wallBounce(float x_bound, float y_bound) {
-        sf::Vector2f tempPosition = ball.getPosition();
-        if (tempPosition.x - radius < 0) {
-            ball.setPosition(radius, tempPosition.y);
-            tempPosition.x = radius;
-            velocity.x *= -material.elasticity;
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
         }
+        wake.notify_all();
+        for (auto& w : workers) {
+            w.join();
+        }
+        workers.clear();
+        quit = false;
+    }
 
-        if (tempPosition.y - radius < 0) {
-            ball.setPosition(tempPosition.x, radius);
-            tempPosition.y = radius;
-            velocity.y *= -material.elasticity;
+    ~WorkerPool() {
+        stop();
+    }
+
+    void runSlice(unsigned int t) {
+        unsigned int n = threadCount();
+        unsigned int begin = static_cast<unsigned long long>(jobSize) * t / n;
+        unsigned int end = static_cast<unsigned long long>(jobSize) * (t + 1) / n;
+        if (begin < end) {
+            job(begin, end);
         }
+    }
 
-        if (tempPosition.x + radius > x_bound) {
-            ball.setPosition(x_bound - radius, tempPosition.y);
-            tempPosition.x = x_bound - radius;
-            velocity.x *= -material.elasticity;
+    void workerLoop(unsigned int t) {
+        unsigned int seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]() { return quit || generation != seen; });
+                if (quit) return;
+                seen = generation;
+            }
+            runSlice(t);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0) done.notify_one();
+            }
         }
+    }
 
-        if (tempPosition.y + radius > y_bound) {
-            ball.setPosition(tempPosition.x, y_bound - radius);
-            tempPosition.y = y_bound - radius;
-            velocity.y *= -material.elasticity;
+    // calls fn(begin, end) over [0, n) split across the pool and blocks until every slice is done
+    void parallelFor(unsigned int n, const std::function<void(unsigned int, unsigned int)>& fn) {
+        if (workers.empty()) {
+            if (n > 0) fn(0, n);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = fn;
+            jobSize = n;
+            pending = workers.size();
+            generation++;
         }
+        wake.notify_all();
+        runSlice(0);
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return pending == 0; });
     }
 };
 
+struct Contact {
+    unsigned int a;
+    unsigned int b;
+    float nx{0.f};            // unit normal from a to b
+    float ny{0.f};
+    float penetration{0.f};
+    float normalMass{0.f};    // 1 / (invMass a + invMass b)
+    float bounce{0.f};        // target separating speed from restitution
+    float impulse{0.f};       // accumulated normal impulse, warm started from the last step
+    float pseudoImpulse{0.f}; // accumulated split impulse, only ever moves positions
+};
+
+// normal impulse a pair ended the last step with, sorted by key for lookup
+struct CachedImpulse {
+    unsigned long long key;
+    float impulse;
+};
+
+// where a ball that moves too far for the discrete step started the step
+struct FastBody {
+    unsigned int i;
+    float x;
+    float y;
+    float vx;
+    float vy;
+};
+
 // enumerations
 enum Direction {up, down, left, right};
 
@@ -193,17 +365,50 @@ unsigned int window_w{default_vals::window_w};
 unsigned int window_h{default_vals::window_h};
 float force{default_vals::force};
 unsigned int num_circles{default_vals::num_circles};
+unsigned int solver_threads{default_vals::solver_threads};
+unsigned int solver_iterations{default_vals::solver_iterations};
+float sleep_time{default_vals::sleep_time};
 
 bool directionFlags[4] = {false, false, false, false};
 bool leftMouseButtonFlag = false;
 bool gfrictionEnabled = false;
+bool broadphaseStatsFlag = false;
 
-BallEntity userBallEntity;
-Material enemy_material{default_vals::enemy::mass, default_vals::enemy::elasticity, default_vals::enemy::friction};
+std::vector<Material> materials = {
+    {default_vals::user::mass, default_vals::user::elasticity, default_vals::user::friction, sf::Color::Green, sf::Color::Red},
+    {default_vals::enemy::mass, default_vals::enemy::elasticity, default_vals::enemy::friction, sf::Color::Blue, sf::Color::Yellow}
+};
+float user_radius{default_vals::user::radius};
 float enemy_radius{default_vals::enemy::radius};
-std::vector<BallEntity> otherBallEntities;
-bool userBallEntityFlag;
-std::vector<bool> otherBallEntitiesFlag;
+BallStore balls;
+BallBatch ballBatch;
+// ball positions before the latest fixed step, so a frame can be drawn between the last two steps
+std::vector<float> previousX;
+std::vector<float> previousY;
+
+SpatialGrid grid;
+WorkerPool workerPool;
+std::vector<Contact> contacts;
+std::vector<Contact> coloredContacts;
+std::vector<unsigned int> colorStart;
+std::vector<unsigned long long> ballColorMask;
+std::vector<CachedImpulse> impulseCache;
+std::vector<float> pseudoVx;
+std::vector<float> pseudoVy;
+std::vector<unsigned int> islandParent;
+std::vector<float> islandQuietTime;
+std::vector<std::vector<unsigned int>> sleepingIslands; // members of every island that is asleep
+std::vector<unsigned int> freeSleepingIslands;
+std::vector<unsigned int> sleepingIslandOf;
+std::vector<unsigned char> queried;
+std::vector<FastBody> fastBodies;
+unsigned long long statsSteps{0};
+unsigned long long statsPairsTested{0};
+unsigned long long statsContactsFound{0};
+// running totals kept whether or not stats are printed, for the headless report
+unsigned long long totalSteps{0};
+unsigned long long totalPairsTested{0};
+unsigned long long totalContactsFound{0};
 
 bool readFromAvailableText() {
     std::string input;
@@ -211,11 +416,21 @@ bool readFromAvailableText() {
     if (settings.is_open()) {
         settings >> window_w >> window_h;
         settings >> force;
-        settings >> userBallEntity.material.mass >> userBallEntity.material.elasticity >> userBallEntity.material.friction;
-        settings >> userBallEntity.radius;
+        settings >> materials[user_material_id].mass >> materials[user_material_id].elasticity >> materials[user_material_id].friction;
+        settings >> user_radius;
         settings >> num_circles;
-        settings >> enemy_material.mass >> enemy_material.elasticity >> enemy_material.friction;
+        settings >> materials[enemy_material_id].mass >> materials[enemy_material_id].elasticity >> materials[enemy_material_id].friction;
         settings >> enemy_radius;
+        // optional from here on, older settings files just stop early
+        if (!(settings >> solver_threads)) {
+            solver_threads = default_vals::solver_threads;
+        }
+        if (!(settings >> solver_iterations)) {
+            solver_iterations = default_vals::solver_iterations;
+        }
+        if (!(settings >> sleep_time)) {
+            sleep_time = default_vals::sleep_time;
+        }
         settings.close();
         return true;
     } else {
@@ -223,33 +438,36 @@ bool readFromAvailableText() {
     }
 }
 
+// forget everything the solver carried over from the previous world
+void resetSolverState() {
+    grid.configure(2.f * enemy_radius, window_w, window_h);
+    impulseCache.clear();
+    sleepingIslands.clear();
+    freeSleepingIslands.clear();
+}
+
 void initializeSettings() {
     if (readFromAvailableText()) {
         std::cout << "hw01_settings.txt successfully loaded.\n";
     } else {
         std::cout << "hw01_settings.txt not loaded. Using default values.\n";
-        userBallEntity.material = {default_vals::user::mass, default_vals::user::elasticity, default_vals::user::friction};
-        userBallEntity.radius = default_vals::user::radius;
-        userBallEntity.setFrictionColors(sf::Color::Green, sf::Color::Red);
     }
 
-    otherBallEntities.resize(num_circles);
+    balls.resize(num_circles + 1);
+    balls.initializeBall(0, window_w / 2.f, window_h - user_radius, user_radius, user_material_id, materials[user_material_id]);
     float borderX = window_w - 4 * enemy_radius;
-    float borderY = window_h - 2 * userBallEntity.radius - 4 * enemy_radius;
-    for (int i = 0; i < num_circles; ++i) {
+    float borderY = window_h - 2 * user_radius - 4 * enemy_radius;
+    for (unsigned int i = 0; i < num_circles; ++i) {
         int row = i / 7;
         int column = i % 7;
-        otherBallEntities[i].material = enemy_material;
-        otherBallEntities[i].radius = enemy_radius;
-        otherBallEntities[i].setFrictionColors(sf::Color::Blue, sf::Color::Yellow);
-        otherBallEntities[i].initializeEntity(borderX / 7.f * column + 4 * enemy_radius, borderY / 5.f * row + 2 * enemy_radius, gfrictionEnabled);
+        balls.initializeBall(i + 1, borderX / 7.f * column + 4 * enemy_radius, borderY / 5.f * row + 2 * enemy_radius,
+                             enemy_radius, enemy_material_id, materials[enemy_material_id]);
     }
+    resetSolverState();
 
-    userBallEntityFlag = true;
-    otherBallEntitiesFlag.resize(num_circles);
-    std::fill(otherBallEntitiesFlag.begin(), otherBallEntitiesFlag.end(), true);
-
-    userBallEntity.initializeEntity(window_w / 2.f, window_h - userBallEntity.radius, gfrictionEnabled);
+    unsigned int threads = solver_threads > 0 ? solver_threads : std::max(1u, std::thread::hardware_concurrency());
+    workerPool.start(threads);
+    std::cout << "contact solver threads: " << workerPool.threadCount() << "\n";
 }
 
 void pressEvents(sf::RenderWindow& window, const sf::Event& event) {
@@ -272,6 +490,10 @@ void pressEvents(sf::RenderWindow& window, const sf::Event& event) {
         case sf::Keyboard::F:
             gfrictionEnabled = !gfrictionEnabled;
             break;
+        case sf::Keyboard::B:
+            broadphaseStatsFlag = !broadphaseStatsFlag;
+            statsSteps = statsPairsTested = statsContactsFound = 0;
+            break;
         default:
             // nothing
             break;
@@ -324,6 +546,584 @@ void handleInput(sf::RenderWindow& window) {
     }
 }
 
+// integrate-and-clamp over a contiguous range of the ball store
+// every kernel below does exactly the same float operations in the same order,
+// so the scalar, SSE and AVX2 paths give bit-identical results
+struct IntegrateParams {
+    float delta;
+    bool frictionEnabled;
+    float x_bound;
+    float y_bound;
+    const float* friction;   // per material
+    const float* elasticity; // per material
+};
+
+std::vector<float> materialFriction;
+std::vector<float> materialElasticity;
+
+void integrateBall(unsigned int i, const sf::Vector2f& acceleration, const IntegrateParams& p, bool clampToWalls = true) {
+    float delta = p.delta;
+    sf::Vector2f nVelocity{balls.vx[i], balls.vy[i]};
+    balls.x[i] += acceleration.x * 0.5f * delta * delta + nVelocity.x * delta;
+    balls.y[i] += acceleration.y * 0.5f * delta * delta + nVelocity.y * delta;
+    nVelocity += acceleration * delta;
+
+    float nVMag = std::sqrt(nVelocity.x * nVelocity.x + nVelocity.y * nVelocity.y);
+    if (p.frictionEnabled && nVMag > epsilon) {
+        sf::Vector2f nVNorm = nVelocity / nVMag;
+        nVMag = std::max(0.f, nVMag - p.friction[balls.material[i]] * delta);
+        nVelocity = nVNorm * nVMag;
+    }
+
+    if (nVMag > epsilon) {
+        balls.vx[i] = nVelocity.x;
+        balls.vy[i] = nVelocity.y;
+    } else {
+        balls.vx[i] = balls.vy[i] = 0.f;
+    }
+
+    if (!clampToWalls) return;
+
+    // snapping; can't think of a better way
+    float r = balls.radius[i];
+    float negElasticity = -p.elasticity[balls.material[i]];
+    if (balls.x[i] - r < 0) {
+        balls.x[i] = r;
+        balls.vx[i] *= negElasticity;
+    }
+    if (balls.y[i] - r < 0) {
+        balls.y[i] = r;
+        balls.vy[i] *= negElasticity;
+    }
+    if (balls.x[i] + r > p.x_bound) {
+        balls.x[i] = p.x_bound - r;
+        balls.vx[i] *= negElasticity;
+    }
+    if (balls.y[i] + r > p.y_bound) {
+        balls.y[i] = p.y_bound - r;
+        balls.vy[i] *= negElasticity;
+    }
+}
+
+void integrateScalar(unsigned int begin, unsigned int end, const IntegrateParams& p) {
+    for (unsigned int i = begin; i < end; ++i) {
+        if (balls.asleep[i]) continue;
+        integrateBall(i, zero_vector, p);
+    }
+}
+
+// sleeping balls have zero velocity and sit inside the walls, so integrating them is a no-op
+// the batched kernels only skip whole blocks of sleepers and let the mixed ones through
+template <unsigned int N>
+bool blockAsleep(unsigned int i) {
+    for (unsigned int k = 0; k < N; ++k) {
+        if (!balls.asleep[i + k]) return false;
+    }
+    return true;
+}
+
+#ifdef HW01_SIMD_X86
+__attribute__((target("sse4.1")))
+void integrateSSE(unsigned int begin, unsigned int end, const IntegrateParams& p) {
+    const __m128 dt = _mm_set1_ps(p.delta);
+    const __m128 eps = _mm_set1_ps(epsilon);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 xb = _mm_set1_ps(p.x_bound);
+    const __m128 yb = _mm_set1_ps(p.y_bound);
+    unsigned int i = begin;
+    for (; i + 4 <= end; i += 4) {
+        if (blockAsleep<4>(i)) continue;
+        __m128 x = _mm_loadu_ps(&balls.x[i]);
+        __m128 y = _mm_loadu_ps(&balls.y[i]);
+        __m128 vx = _mm_loadu_ps(&balls.vx[i]);
+        __m128 vy = _mm_loadu_ps(&balls.vy[i]);
+        __m128 r = _mm_loadu_ps(&balls.radius[i]);
+        const unsigned int* mat = &balls.material[i];
+        __m128 fr = _mm_setr_ps(p.friction[mat[0]], p.friction[mat[1]], p.friction[mat[2]], p.friction[mat[3]]);
+        __m128 negE = _mm_setr_ps(-p.elasticity[mat[0]], -p.elasticity[mat[1]], -p.elasticity[mat[2]], -p.elasticity[mat[3]]);
+
+        x = _mm_add_ps(x, _mm_mul_ps(vx, dt));
+        y = _mm_add_ps(y, _mm_mul_ps(vy, dt));
+
+        __m128 speed = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)));
+        __m128 moving = _mm_cmpgt_ps(speed, eps);
+        if (p.frictionEnabled) {
+            __m128 nSpeed = _mm_max_ps(zero, _mm_sub_ps(speed, _mm_mul_ps(fr, dt)));
+            vx = _mm_blendv_ps(vx, _mm_mul_ps(_mm_div_ps(vx, speed), nSpeed), moving);
+            vy = _mm_blendv_ps(vy, _mm_mul_ps(_mm_div_ps(vy, speed), nSpeed), moving);
+            speed = _mm_blendv_ps(speed, nSpeed, moving);
+            moving = _mm_cmpgt_ps(speed, eps);
+        }
+        vx = _mm_and_ps(vx, moving);
+        vy = _mm_and_ps(vy, moving);
+
+        __m128 hit = _mm_cmplt_ps(_mm_sub_ps(x, r), zero);
+        x = _mm_blendv_ps(x, r, hit);
+        vx = _mm_blendv_ps(vx, _mm_mul_ps(vx, negE), hit);
+        hit = _mm_cmplt_ps(_mm_sub_ps(y, r), zero);
+        y = _mm_blendv_ps(y, r, hit);
+        vy = _mm_blendv_ps(vy, _mm_mul_ps(vy, negE), hit);
+        hit = _mm_cmpgt_ps(_mm_add_ps(x, r), xb);
+        x = _mm_blendv_ps(x, _mm_sub_ps(xb, r), hit);
+        vx = _mm_blendv_ps(vx, _mm_mul_ps(vx, negE), hit);
+        hit = _mm_cmpgt_ps(_mm_add_ps(y, r), yb);
+        y = _mm_blendv_ps(y, _mm_sub_ps(yb, r), hit);
+        vy = _mm_blendv_ps(vy, _mm_mul_ps(vy, negE), hit);
+
+        _mm_storeu_ps(&balls.x[i], x);
+        _mm_storeu_ps(&balls.y[i], y);
+        _mm_storeu_ps(&balls.vx[i], vx);
+        _mm_storeu_ps(&balls.vy[i], vy);
+    }
+    integrateScalar(i, end, p);
+}
+
+__attribute__((target("avx2")))
+void integrateAVX2(unsigned int begin, unsigned int end, const IntegrateParams& p) {
+    const __m256 dt = _mm256_set1_ps(p.delta);
+    const __m256 eps = _mm256_set1_ps(epsilon);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 signBit = _mm256_set1_ps(-0.f);
+    const __m256 xb = _mm256_set1_ps(p.x_bound);
+    const __m256 yb = _mm256_set1_ps(p.y_bound);
+    unsigned int i = begin;
+    for (; i + 8 <= end; i += 8) {
+        if (blockAsleep<8>(i)) continue;
+        __m256 x = _mm256_loadu_ps(&balls.x[i]);
+        __m256 y = _mm256_loadu_ps(&balls.y[i]);
+        __m256 vx = _mm256_loadu_ps(&balls.vx[i]);
+        __m256 vy = _mm256_loadu_ps(&balls.vy[i]);
+        __m256 r = _mm256_loadu_ps(&balls.radius[i]);
+        __m256i mat = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&balls.material[i]));
+        __m256 fr = _mm256_i32gather_ps(p.friction, mat, 4);
+        __m256 negE = _mm256_xor_ps(_mm256_i32gather_ps(p.elasticity, mat, 4), signBit);
+
+        x = _mm256_add_ps(x, _mm256_mul_ps(vx, dt));
+        y = _mm256_add_ps(y, _mm256_mul_ps(vy, dt));
+
+        __m256 speed = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+        __m256 moving = _mm256_cmp_ps(speed, eps, _CMP_GT_OQ);
+        if (p.frictionEnabled) {
+            __m256 nSpeed = _mm256_max_ps(zero, _mm256_sub_ps(speed, _mm256_mul_ps(fr, dt)));
+            vx = _mm256_blendv_ps(vx, _mm256_mul_ps(_mm256_div_ps(vx, speed), nSpeed), moving);
+            vy = _mm256_blendv_ps(vy, _mm256_mul_ps(_mm256_div_ps(vy, speed), nSpeed), moving);
+            speed = _mm256_blendv_ps(speed, nSpeed, moving);
+            moving = _mm256_cmp_ps(speed, eps, _CMP_GT_OQ);
+        }
+        vx = _mm256_and_ps(vx, moving);
+        vy = _mm256_and_ps(vy, moving);
+
+        __m256 hit = _mm256_cmp_ps(_mm256_sub_ps(x, r), zero, _CMP_LT_OQ);
+        x = _mm256_blendv_ps(x, r, hit);
+        vx = _mm256_blendv_ps(vx, _mm256_mul_ps(vx, negE), hit);
+        hit = _mm256_cmp_ps(_mm256_sub_ps(y, r), zero, _CMP_LT_OQ);
+        y = _mm256_blendv_ps(y, r, hit);
+        vy = _mm256_blendv_ps(vy, _mm256_mul_ps(vy, negE), hit);
+        hit = _mm256_cmp_ps(_mm256_add_ps(x, r), xb, _CMP_GT_OQ);
+        x = _mm256_blendv_ps(x, _mm256_sub_ps(xb, r), hit);
+        vx = _mm256_blendv_ps(vx, _mm256_mul_ps(vx, negE), hit);
+        hit = _mm256_cmp_ps(_mm256_add_ps(y, r), yb, _CMP_GT_OQ);
+        y = _mm256_blendv_ps(y, _mm256_sub_ps(yb, r), hit);
+        vy = _mm256_blendv_ps(vy, _mm256_mul_ps(vy, negE), hit);
+
+        _mm256_storeu_ps(&balls.x[i], x);
+        _mm256_storeu_ps(&balls.y[i], y);
+        _mm256_storeu_ps(&balls.vx[i], vx);
+        _mm256_storeu_ps(&balls.vy[i], vy);
+    }
+    integrateScalar(i, end, p);
+}
+#endif
+
+typedef void (*IntegrateKernel)(unsigned int, unsigned int, const IntegrateParams&);
+
+// picked once at startup from what the CPU running this actually supports
+IntegrateKernel pickIntegrateKernel(std::string& name) {
+#ifdef HW01_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        name = "avx2";
+        return integrateAVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        name = "sse4.1";
+        return integrateSSE;
+    }
+#endif
+    name = "scalar";
+    return integrateScalar;
+}
+
+IntegrateKernel integrateKernel = integrateScalar;
+
+void initializeIntegrator() {
+    materialFriction.resize(materials.size());
+    materialElasticity.resize(materials.size());
+    for (unsigned int m = 0; m < materials.size(); ++m) {
+        materialFriction[m] = materials[m].friction;
+        materialElasticity[m] = materials[m].elasticity;
+    }
+
+    std::string name;
+    integrateKernel = pickIntegrateKernel(name);
+    std::cout << "integrator: " << name << "\n";
+}
+
+// greedy edge coloring of the contact graph: a contact gets the lowest color neither of its balls uses yet
+// so no two contacts of one color share a ball and a whole color can be resolved at once
+// contacts that would need more than 64 colors go into one extra batch that is resolved serially
+constexpr unsigned int max_contact_colors{64};
+
+void colorContacts() {
+    ballColorMask.assign(balls.size(), 0);
+    std::vector<unsigned int> contactColor(contacts.size());
+    colorStart.assign(max_contact_colors + 2, 0);
+    for (unsigned int k = 0; k < contacts.size(); ++k) {
+        unsigned long long used = ballColorMask[contacts[k].a] | ballColorMask[contacts[k].b];
+        unsigned int color = max_contact_colors;
+        if (~used != 0) {
+            color = __builtin_ctzll(~used);
+            ballColorMask[contacts[k].a] |= 1ULL << color;
+            ballColorMask[contacts[k].b] |= 1ULL << color;
+        }
+        contactColor[k] = color;
+        colorStart[color + 1]++;
+    }
+    for (unsigned int c = 1; c < colorStart.size(); ++c) {
+        colorStart[c] += colorStart[c - 1];
+    }
+    // stable counting sort keeps the broadphase order inside every color
+    coloredContacts.resize(contacts.size());
+    std::vector<unsigned int> cursor(colorStart.begin(), colorStart.end() - 1);
+    for (unsigned int k = 0; k < contacts.size(); ++k) {
+        coloredContacts[cursor[contactColor[k]]++] = contacts[k];
+    }
+}
+
+// batches below this size are not worth waking the pool for
+constexpr unsigned int min_parallel_batch{256};
+
+// runs resolve(from, to) over every color batch of coloredContacts in color order
+template <typename F>
+void forEachContactBatch(F&& resolve) {
+    for (unsigned int c = 0; c < max_contact_colors; ++c) {
+        unsigned int begin = colorStart[c];
+        unsigned int count = colorStart[c + 1] - begin;
+        if (count >= min_parallel_batch) {
+            workerPool.parallelFor(count, [&](unsigned int from, unsigned int to) {
+                resolve(begin + from, begin + to);
+            });
+        } else if (count > 0) {
+            resolve(begin, begin + count);
+        }
+    }
+    resolve(colorStart[max_contact_colors], colorStart[max_contact_colors + 1]);
+}
+
+unsigned long long contactKey(unsigned int a, unsigned int b) {
+    return (static_cast<unsigned long long>(a) << 32) | b;
+}
+
+// sequential impulse tuning
+constexpr float baumgarte{0.2f};             // fraction of the penetration the split impulse removes per step
+constexpr float penetration_slop{0.5f};      // pixels of overlap left alone so resting contacts don't flicker
+constexpr float restitution_threshold{20.f}; // closing speeds below this don't bounce
+
+void prepareContacts() {
+    for (Contact& c : coloredContacts) {
+        float dx = balls.x[c.b] - balls.x[c.a];
+        float dy = balls.y[c.b] - balls.y[c.a];
+        float dist = std::sqrt(dx * dx + dy * dy);
+        if (dist > epsilon) {
+            c.nx = dx / dist;
+            c.ny = dy / dist;
+        } else {
+            c.nx = 1.f;
+            c.ny = 0.f;
+        }
+        c.penetration = balls.radius[c.a] + balls.radius[c.b] - dist;
+        float sum_inverse_masses = balls.invMass[c.a] + balls.invMass[c.b];
+        c.normalMass = sum_inverse_masses > epsilon ? 1.f / sum_inverse_masses : 0.f;
+
+        // note: the "elasticity" is also known as the coefficient of restitution
+        // a pair bounces with the larger of its two elasticities
+        float vn = (balls.vx[c.b] - balls.vx[c.a]) * c.nx + (balls.vy[c.b] - balls.vy[c.a]) * c.ny;
+        float elasticity = std::max(materials[balls.material[c.a]].elasticity, materials[balls.material[c.b]].elasticity);
+        c.bounce = vn < -restitution_threshold ? -elasticity * vn : 0.f;
+
+        unsigned long long key = contactKey(c.a, c.b);
+        auto cached = std::lower_bound(impulseCache.begin(), impulseCache.end(), key,
+                                       [](const CachedImpulse& ci, unsigned long long k) { return ci.key < k; });
+        c.impulse = (cached != impulseCache.end() && cached->key == key) ? cached->impulse : 0.f;
+        c.pseudoImpulse = 0.f;
+    }
+}
+
+void applyImpulse(const Contact& c, float impulse) {
+    float px = c.nx * impulse;
+    float py = c.ny * impulse;
+    balls.vx[c.a] -= px * balls.invMass[c.a];
+    balls.vy[c.a] -= py * balls.invMass[c.a];
+    balls.vx[c.b] += px * balls.invMass[c.b];
+    balls.vy[c.b] += py * balls.invMass[c.b];
+}
+
+// iterative sequential impulses over the colored contact batches
+// velocities only get the non-penetration/restitution constraint, warm started from last step's impulses;
+// the overlap is removed separately through pseudo velocities that never feed back into the real ones
+void solveContacts(float delta) {
+    colorContacts();
+    prepareContacts();
+
+    forEachContactBatch([](unsigned int from, unsigned int to) {
+        for (unsigned int k = from; k < to; ++k) {
+            applyImpulse(coloredContacts[k], coloredContacts[k].impulse);
+        }
+    });
+
+    for (unsigned int it = 0; it < solver_iterations; ++it) {
+        forEachContactBatch([](unsigned int from, unsigned int to) {
+            for (unsigned int k = from; k < to; ++k) {
+                Contact& c = coloredContacts[k];
+                float vn = (balls.vx[c.b] - balls.vx[c.a]) * c.nx + (balls.vy[c.b] - balls.vy[c.a]) * c.ny;
+                float newImpulse = std::max(c.impulse + c.normalMass * (c.bounce - vn), 0.f);
+                applyImpulse(c, newImpulse - c.impulse);
+                c.impulse = newImpulse;
+            }
+        });
+    }
+
+    // split impulse position correction
+    pseudoVx.assign(balls.size(), 0.f);
+    pseudoVy.assign(balls.size(), 0.f);
+    float biasFactor = baumgarte / delta;
+    for (unsigned int it = 0; it < solver_iterations; ++it) {
+        forEachContactBatch([biasFactor](unsigned int from, unsigned int to) {
+            for (unsigned int k = from; k < to; ++k) {
+                Contact& c = coloredContacts[k];
+                float vn = (pseudoVx[c.b] - pseudoVx[c.a]) * c.nx + (pseudoVy[c.b] - pseudoVy[c.a]) * c.ny;
+                float bias = biasFactor * std::max(c.penetration - penetration_slop, 0.f);
+                float newImpulse = std::max(c.pseudoImpulse + c.normalMass * (bias - vn), 0.f);
+                float applied = newImpulse - c.pseudoImpulse;
+                c.pseudoImpulse = newImpulse;
+                pseudoVx[c.a] -= c.nx * applied * balls.invMass[c.a];
+                pseudoVy[c.a] -= c.ny * applied * balls.invMass[c.a];
+                pseudoVx[c.b] += c.nx * applied * balls.invMass[c.b];
+                pseudoVy[c.b] += c.ny * applied * balls.invMass[c.b];
+            }
+        });
+    }
+    for (unsigned int i = 0; i < balls.size(); ++i) {
+        if (pseudoVx[i] == 0.f && pseudoVy[i] == 0.f) continue;
+        // the walls win over the position correction
+        float r = balls.radius[i];
+        balls.x[i] = std::max(r, std::min(window_w - r, balls.x[i] + pseudoVx[i] * delta));
+        balls.y[i] = std::max(r, std::min(window_h - r, balls.y[i] + pseudoVy[i] * delta));
+    }
+
+    impulseCache.resize(coloredContacts.size());
+    for (unsigned int k = 0; k < coloredContacts.size(); ++k) {
+        impulseCache[k] = {contactKey(coloredContacts[k].a, coloredContacts[k].b), coloredContacts[k].impulse};
+    }
+    std::sort(impulseCache.begin(), impulseCache.end(),
+              [](const CachedImpulse& l, const CachedImpulse& r) { return l.key < r.key; });
+}
+
+// sleeping
+constexpr float sleep_speed{2.f};       // balls slower than this count as resting
+constexpr float user_wake_margin{20.f}; // sleepers this close to the user ball wake up before it touches them
+
+void wakeBall(unsigned int i) {
+    if (!balls.asleep[i]) return;
+    unsigned int id = sleepingIslandOf[i];
+    for (unsigned int m : sleepingIslands[id]) {
+        balls.asleep[m] = 0;
+        balls.quietTime[m] = 0.f;
+    }
+    sleepingIslands[id].clear();
+    freeSleepingIslands.push_back(id);
+}
+
+unsigned int findIsland(unsigned int i) {
+    while (islandParent[i] != i) {
+        islandParent[i] = islandParent[islandParent[i]];
+        i = islandParent[i];
+    }
+    return i;
+}
+
+// islands are the connected components of this step's contact graph
+// an island sleeps once every ball in it has been resting for sleep_time; the user ball's island never does
+void updateSleeping(float delta) {
+    if (sleep_time <= 0.f) return;
+
+    unsigned int n = balls.size();
+    islandParent.resize(n);
+    islandQuietTime.resize(n);
+    sleepingIslandOf.resize(n);
+    for (unsigned int i = 0; i < n; ++i) {
+        if (balls.asleep[i]) continue;
+        islandParent[i] = i;
+        float speed2 = balls.vx[i] * balls.vx[i] + balls.vy[i] * balls.vy[i];
+        balls.quietTime[i] = speed2 < sleep_speed * sleep_speed ? balls.quietTime[i] + delta : 0.f;
+    }
+    balls.quietTime[0] = 0.f;
+
+    for (const Contact& c : coloredContacts) {
+        unsigned int ra = findIsland(c.a);
+        unsigned int rb = findIsland(c.b);
+        if (ra != rb) {
+            // the smaller index becomes the root so the result doesn't depend on contact order
+            islandParent[std::max(ra, rb)] = std::min(ra, rb);
+        }
+    }
+
+    for (unsigned int i = 0; i < n; ++i) {
+        if (!balls.asleep[i]) islandQuietTime[i] = balls.quietTime[i];
+    }
+    for (unsigned int i = 0; i < n; ++i) {
+        if (balls.asleep[i]) continue;
+        unsigned int root = findIsland(i);
+        islandQuietTime[root] = std::min(islandQuietTime[root], balls.quietTime[i]);
+    }
+
+    // roots come before their members, so the root opens the island's slot before anyone joins it
+    for (unsigned int i = 0; i < n; ++i) {
+        if (balls.asleep[i]) continue;
+        unsigned int root = findIsland(i);
+        if (islandQuietTime[root] < sleep_time) continue;
+        if (root == i) {
+            unsigned int id;
+            if (freeSleepingIslands.empty()) {
+                id = sleepingIslands.size();
+                sleepingIslands.emplace_back();
+            } else {
+                id = freeSleepingIslands.back();
+                freeSleepingIslands.pop_back();
+            }
+            sleepingIslandOf[i] = id;
+        } else {
+            sleepingIslandOf[i] = sleepingIslandOf[root];
+        }
+        sleepingIslands[sleepingIslandOf[i]].push_back(i);
+        balls.asleep[i] = 1;
+        balls.vx[i] = balls.vy[i] = 0.f;
+    }
+}
+
+// continuous collision for fast balls
+// a ball that would move more than ccd_threshold of its radius in one step is swept along its path instead:
+// walls are hit analytically and reflected, and the sweep stops at the first ball it would reach,
+// already ccd_skin inside it so the contact is picked up by the solver in this same step
+constexpr float ccd_threshold{0.5f};
+constexpr float ccd_skin{0.25f};
+constexpr unsigned int ccd_max_bounces{4};
+
+void collectFastBodies(const sf::Vector2f& userAcceleration, float delta) {
+    fastBodies.clear();
+    float userReach = 0.5f * std::hypot(userAcceleration.x, userAcceleration.y) * delta * delta;
+    for (unsigned int i = 0; i < balls.size(); ++i) {
+        if (balls.asleep[i]) continue;
+        float reach = std::sqrt(balls.vx[i] * balls.vx[i] + balls.vy[i] * balls.vy[i]) * delta + (i == 0 ? userReach : 0.f);
+        if (reach > ccd_threshold * balls.radius[i]) {
+            fastBodies.push_back({i, balls.x[i], balls.y[i], balls.vx[i], balls.vy[i]});
+        }
+    }
+}
+
+// earliest fraction t in [0, 1) at which a circle of radius r at s moving by d first hits the walls, or 1
+float wallTimeOfImpact(float sx, float sy, float dx, float dy, float r, float x_bound, float y_bound, int& axis) {
+    float toi = 1.f;
+    axis = -1;
+    auto check = [&](float t, int a) {
+        t = std::max(t, 0.f);
+        if (t < toi) {
+            toi = t;
+            axis = a;
+        }
+    };
+    if (dx < 0) check((r - sx) / dx, 0);
+    if (dx > 0) check((x_bound - r - sx) / dx, 0);
+    if (dy < 0) check((r - sy) / dy, 1);
+    if (dy > 0) check((y_bound - r - sy) / dy, 1);
+    return toi;
+}
+
+// earliest fraction t in [0, toi) at which a circle at s moving by d comes within distance R of c
+// pairs that already start closer than R are left to the solver
+bool circleTimeOfImpact(float sx, float sy, float dx, float dy, float cx, float cy, float R, float& toi) {
+    float mx = sx - cx;
+    float my = sy - cy;
+    float c = mx * mx + my * my - R * R;
+    if (c <= 0.f) return false;
+    float a = dx * dx + dy * dy;
+    float b = mx * dx + my * dy;
+    if (a <= epsilon || b >= 0.f) return false; // not moving towards it
+    float disc = b * b - a * c;
+    if (disc < 0.f) return false;
+    float t = (-b - std::sqrt(disc)) / a;
+    if (t < 0.f || t >= toi) return false;
+    toi = t;
+    return true;
+}
+
+void sweepBall(unsigned int i, float sx, float sy, const IntegrateParams& p) {
+    float r = balls.radius[i];
+    float dx = balls.x[i] - sx;
+    float dy = balls.y[i] - sy;
+    float negElasticity = -p.elasticity[balls.material[i]];
+
+    for (unsigned int bounce = 0; bounce < ccd_max_bounces; ++bounce) {
+        int wallAxis;
+        float toi = wallTimeOfImpact(sx, sy, dx, dy, r, p.x_bound, p.y_bound, wallAxis);
+
+        int hit = -1;
+        float midX = sx + dx * 0.5f;
+        float midY = sy + dy * 0.5f;
+        float reach = 0.5f * std::max(std::fabs(dx), std::fabs(dy)) + r + enemy_radius;
+        grid.forEachNear(midX, midY, reach, [&](unsigned int j) {
+            if (j == i) return;
+            if (circleTimeOfImpact(sx, sy, dx, dy, balls.x[j], balls.y[j], r + balls.radius[j] - ccd_skin, toi)) {
+                hit = j;
+            }
+        });
+
+        sx += dx * toi;
+        sy += dy * toi;
+        if (hit >= 0) {
+            wakeBall(hit);
+            break;
+        }
+        if (wallAxis < 0) break;
+
+        // reflect whatever is left of the move off the wall, the same way the clamp treats velocity
+        dx *= 1.f - toi;
+        dy *= 1.f - toi;
+        if (wallAxis == 0) {
+            dx *= negElasticity;
+            balls.vx[i] *= negElasticity;
+        } else {
+            dy *= negElasticity;
+            balls.vy[i] *= negElasticity;
+        }
+    }
+
+    balls.x[i] = std::max(r, std::min(p.x_bound - r, sx));
+    balls.y[i] = std::max(r, std::min(p.y_bound - r, sy));
+}
+
+// redoes every fast ball's move as a sweep against the walls and the other balls' end-of-step positions
+void sweepFastBodies(const sf::Vector2f& userAcceleration, const IntegrateParams& p) {
+    for (const FastBody& f : fastBodies) {
+        balls.x[f.i] = f.x;
+        balls.y[f.i] = f.y;
+        balls.vx[f.i] = f.vx;
+        balls.vy[f.i] = f.vy;
+        integrateBall(f.i, f.i == 0 ? userAcceleration : zero_vector, p, false);
+        sweepBall(f.i, f.x, f.y, p);
+    }
+}
+
 // note: if it's instantaneous acceleration, use a local variable instead
 void update(const sf::Time& elapsed) {
     float delta = elapsed.asSeconds();
@@ -336,61 +1136,524 @@ void update(const sf::Time& elapsed) {
     if (directionFlags[static_cast<unsigned int>(Direction::right)]) dir.x += 69.f;
     float dir_mag = std::hypot(dir.x, dir.y);
     if (dir_mag > epsilon) {
-        acceleration = (dir / dir_mag) * force / userBallEntity.material.mass;
+        acceleration = (dir / dir_mag) * force / materials[user_material_id].mass;
     }
 
-    userBallEntityFlag = false;
-    std::fill(otherBallEntitiesFlag.begin(), otherBallEntitiesFlag.end(), false);
+    // move first and resolve wall interpenetrations in the same pass
+    // only the user ball accelerates, everything after it goes through the batched kernel
+    IntegrateParams params{delta, gfrictionEnabled, static_cast<float>(window_w), static_cast<float>(window_h),
+                           materialFriction.data(), materialElasticity.data()};
+    collectFastBodies(acceleration, delta);
+    integrateBall(0, acceleration, params);
+    integrateKernel(1, balls.size(), params);
 
-    // move first
-    userBallEntity.moveEntity(acceleration, delta, gfrictionEnabled);
-    for (int i = 0; i < num_circles; ++i) {
-        otherBallEntities[i].moveEntity(zero_vector, delta, gfrictionEnabled);
+    // only pairs sharing a neighbourhood of grid cells reach the narrowphase
+    // every ball after the user ball is an enemy, so reaching by one enemy radius finds all j > i
+    // only awake balls look around, and a pair is tested by whichever of its balls looks first;
+    // sleepers never look, so two sleepers are never tested, and a sleeper is woken once something touches it
+    grid.rebuild(balls);
+    if (!fastBodies.empty()) {
+        sweepFastBodies(acceleration, params);
+        grid.rebuild(balls);
+    }
+    unsigned long long pairsTested = 0;
+    unsigned int awakeCount = 0;
+    contacts.clear();
+    queried.assign(balls.size(), 0);
+    for (unsigned int i = 0; i < balls.size(); ++i) {
+        if (balls.asleep[i]) continue;
+        ++awakeCount;
+        queried[i] = 1;
+        float margin = i == 0 ? user_wake_margin : 0.f;
+        grid.forEachNear(balls.x[i], balls.y[i], balls.radius[i] + enemy_radius + margin, [&](unsigned int j) {
+            if (queried[j]) return;
+            ++pairsTested;
+            float dx = balls.x[j] - balls.x[i];
+            float dy = balls.y[j] - balls.y[i];
+            float r = balls.radius[i] + balls.radius[j];
+            if (dx * dx + dy * dy < (r + margin) * (r + margin)) {
+                wakeBall(j);
+            }
+            if (dx * dx + dy * dy < r * r) {
+                contacts.push_back({std::min(i, j), std::max(i, j)});
+            }
+        });
     }
+    unsigned long long contactsFound = contacts.size();
+    solveContacts(delta);
+    updateSleeping(delta);
 
-    // resolve interpenetrations
-    userBallEntity.wallBounce(window_w, window_h);
-    for (int i = 0; i < num_circles; ++i) {
-        otherBallEntities[i].wallBounce(window_w, window_h);
+    totalSteps++;
+    totalPairsTested += pairsTested;
+    totalContactsFound += contactsFound;
+    if (broadphaseStatsFlag) {
+        statsSteps++;
+        statsPairsTested += pairsTested;
+        statsContactsFound += contactsFound;
+        // report about once a second of simulated time
+        if (statsSteps * delta >= 1.f) {
+            std::cout << "balls: " << num_circles + 1
+                      << " | awake: " << awakeCount
+                      << " | pairs tested/step: " << statsPairsTested / statsSteps
+                      << " | contacts/step: " << statsContactsFound / statsSteps
+                      << " | pairs/ball: " << static_cast<float>(statsPairsTested) / statsSteps / (num_circles + 1)
+                      << " | brute force pairs: " << static_cast<unsigned long long>(num_circles + 1) * num_circles / 2 << "\n";
+            statsSteps = statsPairsTested = statsContactsFound = 0;
+        }
     }
+}
+
+void snapshotPositions() {
+    previousX = balls.x;
+    previousY = balls.y;
+}
+
+void initializeShapes() {
+    ballBatch.initializeTexture();
+    ballBatch.resize(balls.size());
+    snapshotPositions();
+}
 
-    for (int i = 0; i < num_circles; ++i) {
-        for (int j = i+1; j < num_circles; ++j) {
-            if (i == j) continue;
-            otherBallEntities[i].collisionWith(otherBallEntities[j]);
+// the only place the physics state is copied into the drawables, blended alpha of the way from the previous step
+// colors only change with the friction toggle, so they are only rewritten then
+void syncShapes(float alpha) {
+    bool rewriteColors = !ballBatch.colorsValid || ballBatch.colorsFriction != gfrictionEnabled;
+    for (unsigned int i = 0; i < balls.size(); ++i) {
+        float x = previousX[i] + (balls.x[i] - previousX[i]) * alpha;
+        float y = previousY[i] + (balls.y[i] - previousY[i]) * alpha;
+        float r = balls.radius[i];
+        sf::Vertex* square = &ballBatch.triangles[i * vertices_per_ball];
+        square[0].position = square[3].position = sf::Vector2f(x - r, y - r);
+        square[1].position = sf::Vector2f(x + r, y - r);
+        square[2].position = square[4].position = sf::Vector2f(x + r, y + r);
+        square[5].position = sf::Vector2f(x - r, y + r);
+        if (rewriteColors) {
+            const Material& m = materials[balls.material[i]];
+            sf::Color color = gfrictionEnabled ? m.colorFriction : m.colorNoFriction;
+            for (unsigned int k = 0; k < vertices_per_ball; ++k) {
+                square[k].color = color;
+            }
         }
-        userBallEntity.collisionWith(otherBallEntities[i]);
     }
+    ballBatch.colorsFriction = gfrictionEnabled;
+    ballBatch.colorsValid = true;
 }
 
-void render(sf::RenderWindow& window) {
+void render(sf::RenderWindow& window, float alpha) {
+    syncShapes(alpha);
     window.clear(sf::Color::Black);
-    window.draw(userBallEntity.ball);
-    for (int i = 0; i < num_circles; ++i) {
-        window.draw(otherBallEntities[i].ball);
-    }
+    ballBatch.draw(window);
     window.display();
 }
 
-int main () {
-    srand(time(NULL));
+// record/replay
+// a recording is the per-step input (direction flags and friction toggle) run-length encoded,
+// plus optionally a checksum of the ball store after every step to find the first step a replay diverges on
+// the simulation is deterministic for a given settings file and build: the integrator kernels agree bit for bit
+// and the contact solver does not depend on the thread count (build without -mfma/-march=native
+// if recordings have to replay the same on different machines)
+constexpr char recording_magic[4] = {'H', 'W', '1', 'R'};
+constexpr std::uint32_t recording_version{1};
+
+struct InputRun {
+    std::uint32_t length;
+    std::uint8_t input;
+};
+
+struct InputRecording {
+    std::uint32_t numCircles{0};
+    std::uint64_t settingsHash{0};
+    std::uint64_t steps{0};
+    std::int64_t fixedStepMicroseconds{0};
+    bool withChecksums{false};
+    std::vector<InputRun> runs;
+    std::vector<std::uint64_t> checksums;
+
+    // replay cursor
+    std::uint64_t cursorStep{0};
+    unsigned int cursorRun{0};
+    std::uint32_t cursorInRun{0};
+
+    void push(std::uint8_t input) {
+        if (!runs.empty() && runs.back().input == input && runs.back().length < UINT32_MAX) {
+            runs.back().length++;
+        } else {
+            runs.push_back({1, input});
+        }
+        steps++;
+    }
+
+    bool next(std::uint8_t& input) {
+        if (cursorStep >= steps || cursorRun >= runs.size()) return false;
+        input = runs[cursorRun].input;
+        if (++cursorInRun == runs[cursorRun].length) {
+            cursorRun++;
+            cursorInRun = 0;
+        }
+        cursorStep++;
+        return true;
+    }
+
+    template <typename T>
+    static void write(std::ofstream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static bool read(std::ifstream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) return false;
+        out.write(recording_magic, sizeof(recording_magic));
+        write(out, recording_version);
+        write(out, numCircles);
+        write(out, settingsHash);
+        write(out, steps);
+        write(out, fixedStepMicroseconds);
+        write(out, static_cast<std::uint8_t>(withChecksums));
+        write(out, static_cast<std::uint32_t>(runs.size()));
+        for (const InputRun& run : runs) {
+            write(out, run.length);
+            write(out, run.input);
+        }
+        if (withChecksums) {
+            out.write(reinterpret_cast<const char*>(checksums.data()), checksums.size() * sizeof(std::uint64_t));
+        }
+        return static_cast<bool>(out);
+    }
+
+    // a truncated or corrupt file is rejected here, so next() never has to trust the header
+    bool load(const std::string& path) {
+        auto reject = [&path](const char* reason) {
+            std::cout << path << ": " << reason << "\n";
+            return false;
+        };
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return reject("cannot be opened");
+        char magic[4];
+        std::uint32_t version, runCount;
+        std::uint8_t checksumFlag;
+        if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, recording_magic, sizeof(magic)) != 0) {
+            return reject("not a recording");
+        }
+        if (!read(in, version) || version != recording_version) return reject("unsupported recording version");
+        if (!read(in, numCircles) || !read(in, settingsHash) || !read(in, steps) || !read(in, fixedStepMicroseconds)
+            || !read(in, checksumFlag) || !read(in, runCount)) {
+            return reject("header ends early");
+        }
+        // every run covers at least one step, so there can't be more runs than steps
+        if (runCount > steps) return reject("more input runs than steps");
+        withChecksums = checksumFlag != 0;
+        runs.resize(runCount);
+        std::uint64_t covered = 0;
+        for (InputRun& run : runs) {
+            if (!read(in, run.length) || !read(in, run.input)) return reject("input runs end early");
+            if (run.length == 0) return reject("zero length input run");
+            covered += run.length;
+        }
+        if (covered != steps) return reject("input runs don't add up to the step count");
+        if (withChecksums) {
+            // size the buffer only once the file is known to hold that many checksums
+            std::streampos start = in.tellg();
+            in.seekg(0, std::ios::end);
+            std::uint64_t left = static_cast<std::uint64_t>(in.tellg() - start);
+            in.seekg(start);
+            if (left / sizeof(std::uint64_t) < steps) return reject("checksums end early");
+            checksums.resize(steps);
+            if (!in.read(reinterpret_cast<char*>(checksums.data()), checksums.size() * sizeof(std::uint64_t))) {
+                return reject("checksums end early");
+            }
+        }
+        return true;
+    }
+};
+
+bool recordingFlag = false;
+bool replayingFlag = false;
+std::string recordingPath;
+InputRecording recording;
+
+std::uint64_t fnv1a(std::uint64_t hash, const void* data, std::size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (std::size_t k = 0; k < size; ++k) {
+        hash = (hash ^ bytes[k]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+constexpr std::uint64_t fnv_offset{14695981039346656037ULL};
+
+std::uint64_t settingsHash() {
+    std::uint64_t hash = fnv_offset;
+    float values[] = {static_cast<float>(window_w), static_cast<float>(window_h), force, user_radius, enemy_radius, sleep_time};
+    hash = fnv1a(hash, values, sizeof(values));
+    for (const Material& m : materials) {
+        float mv[] = {m.mass, m.elasticity, m.friction};
+        hash = fnv1a(hash, mv, sizeof(mv));
+    }
+    hash = fnv1a(hash, &num_circles, sizeof(num_circles));
+    hash = fnv1a(hash, &solver_iterations, sizeof(solver_iterations));
+    return hash;
+}
+
+std::uint64_t stateChecksum() {
+    std::uint64_t hash = fnv_offset;
+    hash = fnv1a(hash, balls.x.data(), balls.size() * sizeof(float));
+    hash = fnv1a(hash, balls.y.data(), balls.size() * sizeof(float));
+    hash = fnv1a(hash, balls.vx.data(), balls.size() * sizeof(float));
+    hash = fnv1a(hash, balls.vy.data(), balls.size() * sizeof(float));
+    return hash;
+}
+
+std::uint8_t packInput() {
+    std::uint8_t input = 0;
+    for (unsigned int d = 0; d < 4; ++d) {
+        input |= directionFlags[d] << d;
+    }
+    return input | (gfrictionEnabled << 4);
+}
+
+void unpackInput(std::uint8_t input) {
+    for (unsigned int d = 0; d < 4; ++d) {
+        directionFlags[d] = (input >> d) & 1;
+    }
+    gfrictionEnabled = (input >> 4) & 1;
+}
+
+void startRecording(const std::string& path, bool withChecksums) {
+    recordingFlag = true;
+    recordingPath = path;
+    recording = InputRecording();
+    recording.numCircles = num_circles;
+    recording.settingsHash = settingsHash();
+    recording.fixedStepMicroseconds = fixed_update_time.asMicroseconds();
+    recording.withChecksums = withChecksums;
+}
+
+void finishRecording() {
+    if (!recordingFlag) return;
+    if (recording.save(recordingPath)) {
+        std::cout << "recorded " << recording.steps << " steps (" << recording.runs.size() << " input runs) to " << recordingPath << "\n";
+    } else {
+        std::cout << "could not write " << recordingPath << "\n";
+    }
+    recordingFlag = false;
+}
+
+bool startReplay(const std::string& path) {
+    if (!recording.load(path)) {
+        std::cout << "could not read recording " << path << "\n";
+        return false;
+    }
+    if (recording.numCircles != num_circles || recording.settingsHash != settingsHash()
+        || recording.fixedStepMicroseconds != fixed_update_time.asMicroseconds()) {
+        std::cout << "warning: " << path << " was recorded with different settings, the replay will not match\n";
+    }
+    replayingFlag = true;
+    std::cout << "replaying " << recording.steps << " steps from " << path << "\n";
+    return true;
+}
+
+// one fixed step with the input coming from the player or the recording
+// returns false once a replay has run out of steps
+bool fixedStep() {
+    if (replayingFlag) {
+        std::uint8_t input;
+        if (!recording.next(input)) return false;
+        unpackInput(input);
+    } else if (recordingFlag) {
+        recording.push(packInput());
+    }
+
+    update(fixed_update_time);
+
+    if (recording.withChecksums && (recordingFlag || replayingFlag)) {
+        std::uint64_t checksum = stateChecksum();
+        if (recordingFlag) {
+            recording.checksums.push_back(checksum);
+        } else if (checksum != recording.checksums[recording.cursorStep - 1]) {
+            std::cout << "replay diverged at step " << recording.cursorStep - 1 << "\n";
+            recording.withChecksums = false; // report only the first one
+        }
+    }
+    return true;
+}
+
+// headless runs: no window, scripted input, as many fixed steps as the machine can do
+long peakResidentKb() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+// the user ball goes around in a square, turning every simulated second
+void scriptedInput(unsigned long long step) {
+    const Direction sides[4] = {Direction::right, Direction::up, Direction::left, Direction::down};
+    unsigned long long second = step * fixed_update_time.asMicroseconds() / 1000000;
+    for (bool& flag : directionFlags) {
+        flag = false;
+    }
+    directionFlags[static_cast<unsigned int>(sides[second % 4])] = true;
+}
+
+// num_circles enemies on a square lattice three radii apart with small pseudo-random velocities,
+// in a world just big enough to hold them and a strip for the user ball
+void initializeLatticeWorld() {
+    unsigned int side = 1;
+    while (side * side < num_circles) {
+        side++;
+    }
+    float spacing = 3.f * enemy_radius;
+    window_w = static_cast<unsigned int>(std::ceil(side * spacing));
+    window_h = static_cast<unsigned int>(std::ceil(side * spacing + 2.f * user_radius + spacing));
+
+    balls.resize(num_circles + 1);
+    balls.initializeBall(0, window_w / 2.f, window_h - user_radius, user_radius, user_material_id, materials[user_material_id]);
+    unsigned int seed = 12345;
+    for (unsigned int i = 0; i < num_circles; ++i) {
+        balls.initializeBall(i + 1, (i % side + 0.5f) * spacing, (i / side + 0.5f) * spacing,
+                             enemy_radius, enemy_material_id, materials[enemy_material_id]);
+        seed = seed * 1103515245u + 12345u;
+        balls.vx[i + 1] = static_cast<float>((seed >> 16) % 201) - 100.f;
+        seed = seed * 1103515245u + 12345u;
+        balls.vy[i + 1] = static_cast<float>((seed >> 16) % 201) - 100.f;
+    }
+    resetSolverState();
+}
+
+void runHeadless(unsigned long long steps) {
+    totalSteps = totalPairsTested = totalContactsFound = 0;
+    sf::Clock clock;
+    for (unsigned long long step = 0; step < steps; ++step) {
+        scriptedInput(step);
+        update(fixed_update_time);
+    }
+    double seconds = clock.getElapsedTime().asSeconds();
+
+    unsigned int awake = std::count(balls.asleep.begin(), balls.asleep.end(), 0);
+    std::cout << std::setw(9) << balls.size()
+              << std::setw(8) << steps
+              << std::setw(14) << std::fixed << std::setprecision(1) << steps / seconds
+              << std::setw(16) << std::setprecision(2) << seconds * 1e9 / (static_cast<double>(steps) * balls.size())
+              << std::setw(9) << awake
+              << std::setw(13) << totalPairsTested / std::max(totalSteps, 1ull)
+              << std::setw(16) << totalContactsFound / std::max(totalSteps, 1ull)
+              << std::setw(12) << static_cast<double>(totalPairsTested) / std::max(totalSteps, 1ull) / balls.size()
+              << std::setw(16) << peakResidentKb() << "\n";
+}
+
+void printHeadlessHeader() {
+    std::cout << std::setw(9) << "balls" << std::setw(8) << "steps" << std::setw(14) << "steps/sec"
+              << std::setw(16) << "ns/ball/step" << std::setw(9) << "awake"
+              << std::setw(13) << "pairs/step" << std::setw(16) << "contacts/step" << std::setw(12) << "pairs/ball"
+              << std::setw(16) << "peak RSS (KB)" << "\n";
+}
+
+// hw01 --headless [steps]            runs the hw01_settings.txt world without a window
+// hw01 --bench [steps]               sweeps 10 to 1M enemies on a lattice world
+// hw01 --record <file> [--checksum]  plays normally and saves the input of every step to file
+// hw01 --replay <file> [--headless]  feeds a recording back through update(), in the window or as fast as possible
+// peak RSS only ever grows, so the sweep goes from small to large
+int runWindowed();
+
+int printUsage() {
+    std::cout << "usage: hw01 [--headless [steps] | --bench [steps] | --record <file> [--checksum] | --replay <file> [--headless]]\n";
+    return 1;
+}
+
+// whole positive numbers only; strtoull alone would take "-5", "12abc" or an overflow without complaint
+bool parseSteps(const char* text, unsigned long long& steps) {
+    if (*text < '0' || *text > '9') return false;
+    char* end = nullptr;
+    errno = 0;
+    steps = std::strtoull(text, &end, 10);
+    return errno == 0 && *end == '\0' && steps > 0;
+}
+
+int runFromCommandLine(int argc, char* argv[]) {
+    std::string mode = argv[1];
+    initializeSettings();
+    initializeIntegrator();
+
+    if (mode == "--headless" || mode == "--bench") {
+        unsigned long long steps = 600;
+        if (argc > 2 && !parseSteps(argv[2], steps)) return printUsage();
+        printHeadlessHeader();
+        if (mode == "--headless") {
+            runHeadless(steps);
+            return 0;
+        }
+        for (unsigned int count = 10; count <= 1000000; count *= 10) {
+            num_circles = count;
+            initializeLatticeWorld();
+            runHeadless(steps);
+        }
+        return 0;
+    }
+    if (mode == "--record" && argc > 2) {
+        startRecording(argv[2], argc > 3 && std::string(argv[3]) == "--checksum");
+        int result = runWindowed();
+        finishRecording();
+        return result;
+    }
+    if (mode == "--replay" && argc > 2) {
+        if (!startReplay(argv[2])) return 1;
+        if (argc > 3 && std::string(argv[3]) == "--headless") {
+            sf::Clock clock;
+            while (fixedStep()) {}
+            double seconds = clock.getElapsedTime().asSeconds();
+            std::cout << "replayed " << recording.steps << " steps in " << seconds << " s ("
+                      << recording.steps / seconds << " steps/sec)\n";
+            return 0;
+        }
+        return runWindowed();
+    }
+    return printUsage();
+}
+
+int runWindowed() {
     sf::RenderWindow window(sf::VideoMode(window_w, window_h), "HW 1");
 	window.setFramerateLimit(fps_limit);
 
-    initializeSettings();
+    initializeShapes();
     
+    FixedTimestep timestep(fixed_update_time, max_substeps);
     sf::Clock clock;
-    sf::Time timeSinceLastUpdate;
     while(window.isOpen()) {
-        sf::Time elapsed = clock.restart();
-        timeSinceLastUpdate += elapsed;
-
         handleInput(window);
-        while (timeSinceLastUpdate >= fixed_update_time) {
-            update(fixed_update_time);
-            timeSinceLastUpdate -= fixed_update_time;
+        // only the state before the frame's last step is needed for blending
+        for (unsigned int steps = timestep.advance(clock.restart()); steps > 0; --steps) {
+            if (steps == 1) {
+                snapshotPositions();
+            }
+            if (!fixedStep()) {
+                window.close();
+                break;
+            }
         }
-        render(window);
+        render(window, timestep.alpha());
     }
     return 0;
+}
+
+int main (int argc, char* argv[]) {
+    srand(time(NULL));
+    if (argc > 1) {
+        return runFromCommandLine(argc, argv);
+    }
+
+    initializeSettings();
+    initializeIntegrator();
+    return runWindowed();
 }
\ No newline at end of file
@@ -0,0 +1,14 @@
+#!/bin/sh
+# linux counterpart of build.bat; links against the system SFML packages
+# e.g. ./build.sh FAQ_CS179.14B_HW01/hw01 && cd FAQ_CS179.14B_HW01 && ./hw01 --bench
+if [ -n "$1" ]; then
+	FILE=$1
+else
+	FILE=main
+fi
+set -x
+g++ -std=c++17 -O2 \
+	"$FILE.cpp" \
+	-o "$FILE" \
+	-pthread \
+	-lsfml-graphics -lsfml-window -lsfml-system
@@ -0,0 +1,35 @@
+#ifndef FIXED_TIMESTEP_HPP
+#define FIXED_TIMESTEP_HPP
+
+#include <SFML/System.hpp>
+
+// fixed timestep loop: frame time is banked and paid out in fixed steps, at most maxSubsteps per frame
+// the bank is clamped to what those steps can use, so a stall (a dragged window, a breakpoint) drops the
+// time it lost instead of spiralling into ever longer frames
+// alpha() is how far the leftover time reaches into the next step, for blending the previous and current
+// state at render time
+struct FixedTimestep {
+    sf::Int64 step;
+    unsigned int maxSubsteps;
+    sf::Int64 accumulator{0};
+
+    FixedTimestep(const sf::Time& fixedStep, unsigned int substeps)
+        : step(fixedStep.asMicroseconds()), maxSubsteps(substeps) {}
+
+    // how many fixed steps to run this frame
+    unsigned int advance(const sf::Time& elapsed) {
+        accumulator += elapsed.asMicroseconds();
+        if (accumulator > step * maxSubsteps) {
+            accumulator = step * maxSubsteps;
+        }
+        unsigned int steps = static_cast<unsigned int>(accumulator / step);
+        accumulator -= steps * step;
+        return steps;
+    }
+
+    float alpha() const {
+        return static_cast<float>(accumulator) / step;
+    }
+};
+
+#endif
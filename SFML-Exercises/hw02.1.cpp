@@ -3,7 +3,20 @@
 #include <cmath> // pow
 #include <fstream>
 #include <vector>
+#include <algorithm>
+#include <unordered_set>
+#include <iomanip>
+#include <string>
+#include <limits>
+#include <cstdlib>
+#include <cerrno>
 #include <SFML/Graphics.hpp>
+#include "fixed_timestep.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HW021_SIMD_X86
+#include <immintrin.h>
+#endif
 
 namespace utility {
     // in case the person compiling this does not have C++17 installed
@@ -20,6 +33,7 @@ namespace utility {
 constexpr unsigned int fps_limit{255};
 constexpr float epsilon{1e-6f};
 const sf::Time fixed_update_time = sf::seconds(1.f/fps_limit);
+constexpr unsigned int max_substeps{16};
 const sf::Vector2f zero_vector{0.f,0.f};
 constexpr float pi{std::acos(-1)};
 constexpr float deg_to_rad{pi/180.f};
@@ -57,6 +71,333 @@ T cross (const sf::Vector2<T>& a, const sf::Vector2<T>& b) {
     return a.x*b.y - b.x*a.y;
 }
 
+// incremental sort and sweep broadphase
+// the min/max endpoints of every box stay sorted on both axes across steps; since the boxes barely move
+// or turn between steps, an insertion sort fixes the order in close to linear time, and every swap of a
+// min past a max is exactly where a pair starts or stops overlapping on that axis
+struct Endpoint {
+    float value;
+    unsigned int box;
+    bool isMax;
+};
+
+struct SweepAndPrune {
+    std::vector<Endpoint> endpoints[2];
+    std::vector<float> minBound[2];
+    std::vector<float> maxBound[2];
+    std::unordered_set<unsigned long long> pairs;
+    std::vector<unsigned int> overlapCount; // how many pairs each box is in
+    bool built{false};
+
+    static unsigned long long pairKey(unsigned int a, unsigned int b) {
+        return a < b ? (static_cast<unsigned long long>(a) << 32) | b : (static_cast<unsigned long long>(b) << 32) | a;
+    }
+
+    // same strict test as sf::FloatRect::intersects
+    bool overlaps(unsigned int a, unsigned int b) const {
+        return minBound[0][a] < maxBound[0][b] && minBound[0][b] < maxBound[0][a]
+            && minBound[1][a] < maxBound[1][b] && minBound[1][b] < maxBound[1][a];
+    }
+
+    // ties put maxes first, so boxes that only touch don't count as overlapping
+    static bool before(const Endpoint& l, const Endpoint& r) {
+        return l.value < r.value || (l.value == r.value && l.isMax && !r.isMax);
+    }
+
+    void addPair(unsigned int a, unsigned int b) {
+        if (pairs.insert(pairKey(a, b)).second) {
+            overlapCount[a]++;
+            overlapCount[b]++;
+        }
+    }
+
+    void removePair(unsigned int a, unsigned int b) {
+        if (pairs.erase(pairKey(a, b)) > 0) {
+            overlapCount[a]--;
+            overlapCount[b]--;
+        }
+    }
+
+    void setBounds(const std::vector<sf::FloatRect>& bounds) {
+        unsigned int n = bounds.size();
+        for (unsigned int axis = 0; axis < 2; ++axis) {
+            minBound[axis].resize(n);
+            maxBound[axis].resize(n);
+        }
+        for (unsigned int i = 0; i < n; ++i) {
+            minBound[0][i] = bounds[i].left;
+            maxBound[0][i] = bounds[i].left + bounds[i].width;
+            minBound[1][i] = bounds[i].top;
+            maxBound[1][i] = bounds[i].top + bounds[i].height;
+        }
+    }
+
+    // full sort and sweep, only for the first step
+    void build(const std::vector<sf::FloatRect>& bounds) {
+        unsigned int n = bounds.size();
+        setBounds(bounds);
+        pairs.clear();
+        overlapCount.assign(n, 0);
+        for (unsigned int axis = 0; axis < 2; ++axis) {
+            endpoints[axis].resize(2 * n);
+            for (unsigned int i = 0; i < n; ++i) {
+                endpoints[axis][2 * i] = {minBound[axis][i], i, false};
+                endpoints[axis][2 * i + 1] = {maxBound[axis][i], i, true};
+            }
+            std::sort(endpoints[axis].begin(), endpoints[axis].end(), before);
+        }
+
+        std::vector<unsigned int> active;
+        for (const Endpoint& e : endpoints[0]) {
+            if (e.isMax) {
+                active.erase(std::find(active.begin(), active.end(), e.box));
+            } else {
+                for (unsigned int other : active) {
+                    if (overlaps(e.box, other)) {
+                        addPair(e.box, other);
+                    }
+                }
+                active.push_back(e.box);
+            }
+        }
+        built = true;
+    }
+
+    void update(const std::vector<sf::FloatRect>& bounds) {
+        if (!built || bounds.size() != overlapCount.size()) {
+            build(bounds);
+            return;
+        }
+        setBounds(bounds);
+        for (unsigned int axis = 0; axis < 2; ++axis) {
+            std::vector<Endpoint>& list = endpoints[axis];
+            for (Endpoint& e : list) {
+                e.value = e.isMax ? maxBound[axis][e.box] : minBound[axis][e.box];
+            }
+            for (unsigned int i = 1; i < list.size(); ++i) {
+                for (unsigned int j = i; j > 0 && before(list[j], list[j - 1]); --j) {
+                    const Endpoint& moving = list[j];
+                    const Endpoint& passed = list[j - 1];
+                    if (!moving.isMax && passed.isMax) {
+                        // a min moved below someone's max: they may overlap now
+                        if (overlaps(moving.box, passed.box)) {
+                            addPair(moving.box, passed.box);
+                        }
+                    } else if (moving.isMax && !passed.isMax) {
+                        // a max moved below someone's min: they are apart on this axis
+                        removePair(moving.box, passed.box);
+                    }
+                    std::swap(list[j], list[j - 1]);
+                }
+            }
+        }
+    }
+};
+
+// every shape here is a rectangle, so they are kept as oriented boxes: center, half extents and the cos/sin of the
+// rotation, one array per field. the bounding box then comes straight from the half extents,
+// and two boxes only need their 4 face axes checked to know if they overlap
+// the boxes are the simulation state: each turns by a fixed angle per step, so its unit axis (c, s) is advanced
+// with that angle's precomputed cos/sin (cr, sr) instead of a cos/sin of the full angle every step
+struct OrientedBoxes {
+    std::vector<float> cx, cy;
+    std::vector<float> hx, hy;
+    std::vector<float> c, s;
+    std::vector<float> cr, sr;
+    unsigned int turns{0};
+
+    void resize(unsigned int n) {
+        cx.resize(n);
+        cy.resize(n);
+        hx.resize(n);
+        hy.resize(n);
+        c.resize(n);
+        s.resize(n);
+        cr.resize(n, 1.f);
+        sr.resize(n, 0.f);
+    }
+
+    void setSpin(unsigned int i, float degreesPerStep) {
+        cr[i] = std::cos(degreesPerStep * deg_to_rad);
+        sr[i] = std::sin(degreesPerStep * deg_to_rad);
+    }
+
+    // the rounding of each turn slowly stretches the axis, so it is pulled back to unit length every so often
+    void turn() {
+        for (unsigned int i = 0; i < c.size(); ++i) {
+            float nc = c[i] * cr[i] - s[i] * sr[i];
+            float ns = s[i] * cr[i] + c[i] * sr[i];
+            c[i] = nc;
+            s[i] = ns;
+        }
+        if (++turns % 256 == 0) {
+            for (unsigned int i = 0; i < c.size(); ++i) {
+                float length = std::sqrt(c[i] * c[i] + s[i] * s[i]);
+                c[i] /= length;
+                s[i] /= length;
+            }
+        }
+    }
+
+    // the origin of every rect is its center, so its position is the box center
+    void set(unsigned int i, const sf::RectangleShape& rect) {
+        float angle = rect.getRotation() * deg_to_rad;
+        cx[i] = rect.getPosition().x;
+        cy[i] = rect.getPosition().y;
+        hx[i] = rect.getSize().x / 2.f;
+        hy[i] = rect.getSize().y / 2.f;
+        c[i] = std::cos(angle);
+        s[i] = std::sin(angle);
+    }
+
+    // the box's extent along x is hx|cos| + hy|sin|, and along y hx|sin| + hy|cos|
+    void computeBounds(std::vector<sf::FloatRect>& bounds) const {
+        for (unsigned int i = 0; i < cx.size(); ++i) {
+            float ac = std::abs(c[i]);
+            float as = std::abs(s[i]);
+            float ex = hx[i] * ac + hy[i] * as;
+            float ey = hx[i] * as + hy[i] * ac;
+            bounds[i] = sf::FloatRect(cx[i] - ex, cy[i] - ey, 2.f * ex, 2.f * ey);
+        }
+    }
+};
+
+// candidate pairs from the broadphase laid out for the batched OBB test
+struct BoxPairs {
+    std::vector<unsigned int> a;
+    std::vector<unsigned int> b;
+    std::vector<unsigned char> hit;
+};
+
+// separating axis test on the two face axes of each box
+// with C = |cos| and S = |sin| of the angle between the boxes, box b's radius along a's x axis is hxB*C + hyB*S, etc.
+bool obbOverlap(const OrientedBoxes& o, unsigned int a, unsigned int b) {
+    float dx = o.cx[b] - o.cx[a];
+    float dy = o.cy[b] - o.cy[a];
+    float C = std::abs(o.c[a] * o.c[b] + o.s[a] * o.s[b]);
+    float S = std::abs(o.c[a] * o.s[b] - o.s[a] * o.c[b]);
+    return !(std::abs(dx * o.c[a] + dy * o.s[a]) > o.hx[a] + o.hx[b] * C + o.hy[b] * S
+          || std::abs(dy * o.c[a] - dx * o.s[a]) > o.hy[a] + o.hx[b] * S + o.hy[b] * C
+          || std::abs(dx * o.c[b] + dy * o.s[b]) > o.hx[b] + o.hx[a] * C + o.hy[a] * S
+          || std::abs(dy * o.c[b] - dx * o.s[b]) > o.hy[b] + o.hx[a] * S + o.hy[a] * C);
+}
+
+void obbScalar(const OrientedBoxes& o, BoxPairs& pairs, unsigned int begin) {
+    for (unsigned int k = begin; k < pairs.a.size(); ++k) {
+        pairs.hit[k] = obbOverlap(o, pairs.a[k], pairs.b[k]);
+    }
+}
+
+// the same test on 4 (SSE) or 8 (AVX2) pairs at once, with the same operation order as obbOverlap
+// so every kernel gives the same answer; leftover pairs go through the scalar version
+#ifdef HW021_SIMD_X86
+__attribute__((target("sse4.1")))
+void obbSSE(const OrientedBoxes& o, BoxPairs& pairs) {
+    const __m128 signMask = _mm_set1_ps(-0.f);
+    unsigned int k = 0;
+    for (; k + 4 <= pairs.a.size(); k += 4) {
+        const unsigned int* a = &pairs.a[k];
+        const unsigned int* b = &pairs.b[k];
+        auto gather = [](const std::vector<float>& field, const unsigned int* idx) {
+            return _mm_setr_ps(field[idx[0]], field[idx[1]], field[idx[2]], field[idx[3]]);
+        };
+        __m128 cxA = gather(o.cx, a), cyA = gather(o.cy, a), hxA = gather(o.hx, a), hyA = gather(o.hy, a);
+        __m128 cA = gather(o.c, a), sA = gather(o.s, a);
+        __m128 cxB = gather(o.cx, b), cyB = gather(o.cy, b), hxB = gather(o.hx, b), hyB = gather(o.hy, b);
+        __m128 cB = gather(o.c, b), sB = gather(o.s, b);
+
+        __m128 dx = _mm_sub_ps(cxB, cxA);
+        __m128 dy = _mm_sub_ps(cyB, cyA);
+        __m128 C = _mm_andnot_ps(signMask, _mm_add_ps(_mm_mul_ps(cA, cB), _mm_mul_ps(sA, sB)));
+        __m128 S = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_mul_ps(cA, sB), _mm_mul_ps(sA, cB)));
+
+        __m128 pa = _mm_andnot_ps(signMask, _mm_add_ps(_mm_mul_ps(dx, cA), _mm_mul_ps(dy, sA)));
+        __m128 ra = _mm_add_ps(_mm_add_ps(hxA, _mm_mul_ps(hxB, C)), _mm_mul_ps(hyB, S));
+        __m128 separated = _mm_cmpgt_ps(pa, ra);
+        pa = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_mul_ps(dy, cA), _mm_mul_ps(dx, sA)));
+        ra = _mm_add_ps(_mm_add_ps(hyA, _mm_mul_ps(hxB, S)), _mm_mul_ps(hyB, C));
+        separated = _mm_or_ps(separated, _mm_cmpgt_ps(pa, ra));
+        pa = _mm_andnot_ps(signMask, _mm_add_ps(_mm_mul_ps(dx, cB), _mm_mul_ps(dy, sB)));
+        ra = _mm_add_ps(_mm_add_ps(hxB, _mm_mul_ps(hxA, C)), _mm_mul_ps(hyA, S));
+        separated = _mm_or_ps(separated, _mm_cmpgt_ps(pa, ra));
+        pa = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_mul_ps(dy, cB), _mm_mul_ps(dx, sB)));
+        ra = _mm_add_ps(_mm_add_ps(hyB, _mm_mul_ps(hxA, S)), _mm_mul_ps(hyA, C));
+        separated = _mm_or_ps(separated, _mm_cmpgt_ps(pa, ra));
+
+        int mask = _mm_movemask_ps(separated);
+        for (unsigned int l = 0; l < 4; ++l) {
+            pairs.hit[k + l] = !(mask & (1 << l));
+        }
+    }
+    obbScalar(o, pairs, k);
+}
+
+__attribute__((target("avx2")))
+void obbAVX2(const OrientedBoxes& o, BoxPairs& pairs) {
+    const __m256 signMask = _mm256_set1_ps(-0.f);
+    unsigned int k = 0;
+    for (; k + 8 <= pairs.a.size(); k += 8) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&pairs.a[k]));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&pairs.b[k]));
+        __m256 cxA = _mm256_i32gather_ps(o.cx.data(), a, 4), cyA = _mm256_i32gather_ps(o.cy.data(), a, 4);
+        __m256 hxA = _mm256_i32gather_ps(o.hx.data(), a, 4), hyA = _mm256_i32gather_ps(o.hy.data(), a, 4);
+        __m256 cA = _mm256_i32gather_ps(o.c.data(), a, 4), sA = _mm256_i32gather_ps(o.s.data(), a, 4);
+        __m256 cxB = _mm256_i32gather_ps(o.cx.data(), b, 4), cyB = _mm256_i32gather_ps(o.cy.data(), b, 4);
+        __m256 hxB = _mm256_i32gather_ps(o.hx.data(), b, 4), hyB = _mm256_i32gather_ps(o.hy.data(), b, 4);
+        __m256 cB = _mm256_i32gather_ps(o.c.data(), b, 4), sB = _mm256_i32gather_ps(o.s.data(), b, 4);
+
+        __m256 dx = _mm256_sub_ps(cxB, cxA);
+        __m256 dy = _mm256_sub_ps(cyB, cyA);
+        __m256 C = _mm256_andnot_ps(signMask, _mm256_add_ps(_mm256_mul_ps(cA, cB), _mm256_mul_ps(sA, sB)));
+        __m256 S = _mm256_andnot_ps(signMask, _mm256_sub_ps(_mm256_mul_ps(cA, sB), _mm256_mul_ps(sA, cB)));
+
+        __m256 pa = _mm256_andnot_ps(signMask, _mm256_add_ps(_mm256_mul_ps(dx, cA), _mm256_mul_ps(dy, sA)));
+        __m256 ra = _mm256_add_ps(_mm256_add_ps(hxA, _mm256_mul_ps(hxB, C)), _mm256_mul_ps(hyB, S));
+        __m256 separated = _mm256_cmp_ps(pa, ra, _CMP_GT_OQ);
+        pa = _mm256_andnot_ps(signMask, _mm256_sub_ps(_mm256_mul_ps(dy, cA), _mm256_mul_ps(dx, sA)));
+        ra = _mm256_add_ps(_mm256_add_ps(hyA, _mm256_mul_ps(hxB, S)), _mm256_mul_ps(hyB, C));
+        separated = _mm256_or_ps(separated, _mm256_cmp_ps(pa, ra, _CMP_GT_OQ));
+        pa = _mm256_andnot_ps(signMask, _mm256_add_ps(_mm256_mul_ps(dx, cB), _mm256_mul_ps(dy, sB)));
+        ra = _mm256_add_ps(_mm256_add_ps(hxB, _mm256_mul_ps(hxA, C)), _mm256_mul_ps(hyA, S));
+        separated = _mm256_or_ps(separated, _mm256_cmp_ps(pa, ra, _CMP_GT_OQ));
+        pa = _mm256_andnot_ps(signMask, _mm256_sub_ps(_mm256_mul_ps(dy, cB), _mm256_mul_ps(dx, sB)));
+        ra = _mm256_add_ps(_mm256_add_ps(hyB, _mm256_mul_ps(hxA, S)), _mm256_mul_ps(hyA, C));
+        separated = _mm256_or_ps(separated, _mm256_cmp_ps(pa, ra, _CMP_GT_OQ));
+
+        int mask = _mm256_movemask_ps(separated);
+        for (unsigned int l = 0; l < 8; ++l) {
+            pairs.hit[k + l] = !(mask & (1 << l));
+        }
+    }
+    obbScalar(o, pairs, k);
+}
+#endif
+
+void obbScalarAll(const OrientedBoxes& o, BoxPairs& pairs) {
+    obbScalar(o, pairs, 0);
+}
+
+typedef void (*ObbKernel)(const OrientedBoxes&, BoxPairs&);
+
+// picked once at startup from what the CPU running this actually supports
+ObbKernel pickObbKernel(std::string& name) {
+#ifdef HW021_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        name = "avx2";
+        return obbAVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        name = "sse4.1";
+        return obbSSE;
+    }
+#endif
+    name = "scalar";
+    return obbScalarAll;
+}
+
+ObbKernel obbKernel = obbScalarAll;
+
 // enumerations
 enum Direction {up, down, left, right};
 
@@ -70,14 +411,18 @@ bool directionFlags[4] = {false, false, false, false};
 bool leftMouseButtonFlag = false;
 
 std::vector<sf::RectangleShape> rects;
-std::vector<sf::RectangleShape> boundingBoxEntity;
 std::vector<sf::FloatRect> boundingBoxValues;
 std::vector<sf::Vector2f> rectSizes;
 std::vector<float> rotation_speed;
+SweepAndPrune sap;
+OrientedBoxes boxes;
+BoxPairs boxPairs;
+std::vector<unsigned char> obbHit;
 
 void resizeVectors(unsigned int size) {
     rects.resize(size);
-    boundingBoxEntity.resize(size);
+    boxes.resize(size);
+    obbHit.assign(size, 0);
     boundingBoxValues.resize(size);
     rectSizes.resize(size);
     rotation_speed.resize(size);
@@ -144,7 +489,14 @@ void initializeSettings() {
             }
         }
     }
-    
+
+    // the rects only lay the scene out; from here on the boxes are moved and drawn
+    // the boxes and bounds start out filled, so the first frame has a real previous state to blend from
+    for (unsigned int i = 0; i < boxes_count; ++i) {
+        boxes.set(i, rects[i]);
+        boxes.setSpin(i, rotation_speed[i]);
+    }
+    boxes.computeBounds(boundingBoxValues);
 }
 
 void pressEvents(sf::RenderWindow& window, const sf::Event& event) {
@@ -227,77 +579,262 @@ void update(const sf::Time& elapsed, sf::RenderWindow& window) {
     float dir_mag = std::hypot(dir.x, dir.y);
     if (dir_mag > epsilon) {
         sf::Vector2f v = (dir / dir_mag) * speed * delta;
-        rects[0].move(v);
+        boxes.cx[0] += v.x;
+        boxes.cy[0] += v.y;
     }
 
     // just prevent the center of mass from getting out
-    if(rects[0].getPosition().x < 0) {
-        rects[0].setPosition(0, rects[0].getPosition().y);
+    if(boxes.cx[0] < 0) {
+        boxes.cx[0] = 0;
     }
-    if(rects[0].getPosition().x > window_w) {
-        rects[0].setPosition(window_w, rects[0].getPosition().y);
+    if(boxes.cx[0] > window_w) {
+        boxes.cx[0] = window_w;
     }
-    if(rects[0].getPosition().y < 0) {
-        rects[0].setPosition(rects[0].getPosition().x, 0);
+    if(boxes.cy[0] < 0) {
+        boxes.cy[0] = 0;
     }
-    if(rects[0].getPosition().y > window_h) {
-        rects[0].setPosition(rects[0].getPosition().x, window_h);
+    if(boxes.cy[0] > window_h) {
+        boxes.cy[0] = window_h;
     }
 
-    for(unsigned int i = 0; i < boxes_count; ++i) {
-        // rectangles
-        rects[i].rotate(rotation_speed[i]);
-        rects[i].setFillColor(sf::Color::White);
+    boxes.turn();
+    boxes.computeBounds(boundingBoxValues);
 
-        // bounding boxes
-        boundingBoxValues[i] = rects[i].getGlobalBounds();
-        boundingBoxEntity[i].setSize(sf::Vector2f(boundingBoxValues[i].width, boundingBoxValues[i].height));
-        boundingBoxEntity[i].setPosition(boundingBoxValues[i].left, boundingBoxValues[i].top); 
-        boundingBoxEntity[i].setFillColor(sf::Color::Transparent);
-        boundingBoxEntity[i].setOutlineThickness(1.0f);
-        boundingBoxEntity[i].setOutlineColor(sf::Color::White);
+    // sap.pairs now holds exactly the pairs whose bounding boxes overlap
+    sap.update(boundingBoxValues);
+    boxPairs.a.clear();
+    boxPairs.b.clear();
+    for (unsigned long long key : sap.pairs) {
+        boxPairs.a.push_back(static_cast<unsigned int>(key >> 32));
+        boxPairs.b.push_back(static_cast<unsigned int>(key & 0xffffffffu));
     }
+    boxPairs.hit.resize(boxPairs.a.size());
+    obbKernel(boxes, boxPairs);
 
-    for(unsigned int i = 0; i < boxes_count; ++i) {
-        for(unsigned int j = i+1; j < boxes_count; ++j) {
-            if(boundingBoxValues[i].intersects(boundingBoxValues[j])) {  
-                rects[i].setFillColor(sf::Color::Green);
-                rects[j].setFillColor(sf::Color::Green);
-                boundingBoxEntity[i].setOutlineColor(sf::Color::Green);
-                boundingBoxEntity[j].setOutlineColor(sf::Color::Green);           
-            }
+    obbHit.assign(boxes_count, 0);
+    for (unsigned int k = 0; k < boxPairs.a.size(); ++k) {
+        if (boxPairs.hit[k]) {
+            obbHit[boxPairs.a[k]] = obbHit[boxPairs.b[k]] = 1;
         }
-    }  
+    }
 }
 
-void render(sf::RenderWindow& window) {
-    window.clear(sf::Color::Black);
+// two triangles for the quad a b c d
+void setQuad(sf::Vertex* v, const sf::Vector2f& a, const sf::Vector2f& b, const sf::Vector2f& c, const sf::Vector2f& d) {
+    v[0].position = a;
+    v[1].position = b;
+    v[2].position = c;
+    v[3].position = a;
+    v[4].position = c;
+    v[5].position = d;
+}
+
+// the outline sf::RectangleShape would draw around r: four quads of the given thickness just outside it
+constexpr unsigned int frame_vertices{24};
+
+void setFrame(sf::Vertex* v, const sf::FloatRect& r, float thickness) {
+    float l = r.left, t = r.top, rr = r.left + r.width, b = r.top + r.height;
+    float o = thickness;
+    setQuad(v, {l - o, t - o}, {rr + o, t - o}, {rr + o, t}, {l - o, t});
+    setQuad(v + 6, {l - o, b}, {rr + o, b}, {rr + o, b + o}, {l - o, b + o});
+    setQuad(v + 12, {l - o, t}, {l, t}, {l, b}, {l - o, b});
+    setQuad(v + 18, {rr, t}, {rr + o, t}, {rr + o, b}, {rr, b});
+}
+
+// box state before the latest fixed step, so a frame can be drawn between the last two steps
+OrientedBoxes previousBoxes;
+std::vector<sf::FloatRect> previousBounds;
+
+void snapshotBoxes() {
+    previousBoxes = boxes;
+    previousBounds = boundingBoxValues;
+}
+
+// every box's fill and bounding box frame in one triangle list, written from the box state once per frame and
+// blended alpha of the way from the previous step
+// green when the bounding boxes overlap, blue when the boxes themselves do
+constexpr unsigned int box_vertices{6 + frame_vertices};
+sf::VertexArray boxBatch{sf::Triangles};
+
+void syncBatch(float alpha) {
+    boxBatch.resize(boxes_count * box_vertices);
+    auto blend = [alpha](float from, float to) { return from + (to - from) * alpha; };
     for (unsigned int i = 0; i < boxes_count; ++i) {
-        window.draw(rects[i]);
-        window.draw(boundingBoxEntity[i]);
+        sf::Vertex* v = &boxBatch[i * box_vertices];
+        sf::Vector2f center(blend(previousBoxes.cx[i], boxes.cx[i]), blend(previousBoxes.cy[i], boxes.cy[i]));
+        // the blended rotation is renormalized so the box keeps its size halfway through a turn
+        sf::Vector2f axis(blend(previousBoxes.c[i], boxes.c[i]), blend(previousBoxes.s[i], boxes.s[i]));
+        float length = std::hypot(axis.x, axis.y);
+        axis = length > epsilon ? axis / length : sf::Vector2f(boxes.c[i], boxes.s[i]);
+        sf::Vector2f u = axis * boxes.hx[i];
+        sf::Vector2f w = sf::Vector2f(-axis.y, axis.x) * boxes.hy[i];
+        setQuad(v, center - u - w, center + u - w, center + u + w, center - u + w);
+        const sf::FloatRect& from = previousBounds[i];
+        const sf::FloatRect& to = boundingBoxValues[i];
+        setFrame(v + 6, sf::FloatRect(blend(from.left, to.left), blend(from.top, to.top),
+                                      blend(from.width, to.width), blend(from.height, to.height)), 1.f);
+
+        bool boxOverlap = i < sap.overlapCount.size() && sap.overlapCount[i] > 0;
+        sf::Color fill = obbHit[i] ? sf::Color::Blue : boxOverlap ? sf::Color::Green : sf::Color::White;
+        sf::Color frame = boxOverlap ? sf::Color::Green : sf::Color::White;
+        for (unsigned int k = 0; k < 6; ++k) v[k].color = fill;
+        for (unsigned int k = 6; k < box_vertices; ++k) v[k].color = frame;
     }
+}
+
+void render(sf::RenderWindow& window, float alpha) {
+    window.clear(sf::Color::Black);
+    syncBatch(alpha);
+    window.draw(boxBatch);
     window.display();
 }
 
-int main () {
+void initializeObbKernel() {
+    std::string name;
+    obbKernel = pickObbKernel(name);
+    std::cout << "obb kernel: " << name << "\n";
+}
+
+// the generic path the oriented boxes replace: 4 corners through the full transform, projected on each edge normal
+bool cornerSAT(const sf::RectangleShape& a, const sf::RectangleShape& b) {
+    sf::Vector2f pa[4], pb[4];
+    for (unsigned int j = 0; j < 4; ++j) {
+        pa[j] = a.getTransform().transformPoint(a.getPoint(j));
+        pb[j] = b.getTransform().transformPoint(b.getPoint(j));
+    }
+    for (unsigned int k = 0; k < 8; ++k) {
+        const sf::Vector2f* p = k < 4 ? pa : pb;
+        sf::Vector2f edge = p[(k+1)%4] - p[k%4];
+        sf::Vector2f axis(-edge.y, edge.x);
+        float amin = dot(axis, pa[0]), amax = amin, bmin = dot(axis, pb[0]), bmax = bmin;
+        for (unsigned int j = 1; j < 4; ++j) {
+            amin = std::min(amin, dot(axis, pa[j]));
+            amax = std::max(amax, dot(axis, pa[j]));
+            bmin = std::min(bmin, dot(axis, pb[j]));
+            bmax = std::max(bmax, dot(axis, pb[j]));
+        }
+        if (amax < bmin || bmax < amin) return false;
+    }
+    return true;
+}
+
+// hw02.1 --bench [boxes]   times generic vs oriented box bounds and narrowphase on a random rectangle scene
+int runBenchmark(unsigned int count) {
+    srand(179);
+    boxes_count = count;
+    resizeVectors(boxes_count);
+    float side = std::sqrt(static_cast<float>(count)) * 60.f;
+    for (unsigned int i = 0; i < boxes_count; ++i) {
+        rectSizes[i] = sf::Vector2f(10.f + rand() % 90, 10.f + rand() % 90);
+        rects[i].setSize(rectSizes[i]);
+        rects[i].setOrigin(rectSizes[i].x / 2, rectSizes[i].y / 2);
+        rects[i].setPosition(side * rand() / RAND_MAX, side * rand() / RAND_MAX);
+        rects[i].setRotation(360.f * rand() / RAND_MAX);
+        rotation_speed[i] = 2.f * rand() / RAND_MAX;
+        boxes.set(i, rects[i]);
+        boxes.setSpin(i, rotation_speed[i]);
+    }
+
+    // one step of turning every box and refreshing its bounds, through the shape and through the boxes
+    const unsigned int rounds = 20;
+    sf::Clock clock;
+    for (unsigned int round = 0; round < rounds; ++round) {
+        for (unsigned int i = 0; i < boxes_count; ++i) {
+            rects[i].rotate(rotation_speed[i]);
+            boundingBoxValues[i] = rects[i].getGlobalBounds();
+        }
+    }
+    double genericBounds = clock.restart().asSeconds() * 1e9 / (static_cast<double>(rounds) * boxes_count);
+    std::vector<sf::FloatRect> genericValues = boundingBoxValues;
+    for (unsigned int round = 0; round < rounds; ++round) {
+        boxes.turn();
+        boxes.computeBounds(boundingBoxValues);
+    }
+    double analyticBounds = clock.restart().asSeconds() * 1e9 / (static_cast<double>(rounds) * boxes_count);
+    float worstBoundsError = 0.f;
+    for (unsigned int i = 0; i < boxes_count; ++i) {
+        worstBoundsError = std::max(worstBoundsError, std::abs(genericValues[i].left - boundingBoxValues[i].left));
+        worstBoundsError = std::max(worstBoundsError, std::abs(genericValues[i].width - boundingBoxValues[i].width));
+    }
+
+    sap.built = false;
+    sap.update(boundingBoxValues);
+    boxPairs.a.clear();
+    boxPairs.b.clear();
+    for (unsigned long long key : sap.pairs) {
+        boxPairs.a.push_back(static_cast<unsigned int>(key >> 32));
+        boxPairs.b.push_back(static_cast<unsigned int>(key & 0xffffffffu));
+    }
+    unsigned int pairCount = boxPairs.a.size();
+    boxPairs.hit.resize(pairCount);
+    std::vector<unsigned char> genericHit(pairCount);
+    clock.restart();
+    for (unsigned int round = 0; round < rounds; ++round) {
+        for (unsigned int k = 0; k < pairCount; ++k) {
+            genericHit[k] = cornerSAT(rects[boxPairs.a[k]], rects[boxPairs.b[k]]);
+        }
+    }
+    double genericPairs = clock.restart().asSeconds() * 1e9 / (static_cast<double>(rounds) * std::max(1u, pairCount));
+    for (unsigned int round = 0; round < rounds; ++round) {
+        obbKernel(boxes, boxPairs);
+    }
+    double obbPairs = clock.restart().asSeconds() * 1e9 / (static_cast<double>(rounds) * std::max(1u, pairCount));
+    unsigned int disagreements = 0;
+    for (unsigned int k = 0; k < pairCount; ++k) {
+        disagreements += genericHit[k] != boxPairs.hit[k];
+    }
+
+    std::cout << std::fixed << std::setprecision(1)
+              << "boxes: " << boxes_count << " | step ns/box: rotate + getGlobalBounds " << genericBounds
+              << ", turn + analytic bounds " << analyticBounds
+              << " | worst bounds difference: " << std::setprecision(4) << worstBoundsError << "\n"
+              << std::setprecision(1)
+              << "pairs: " << pairCount << " | narrowphase ns/pair: corner SAT " << genericPairs << ", OBB kernel " << obbPairs
+              << " | disagreements: " << disagreements << "\n";
+    return 0;
+}
+
+// whole positive numbers only; stoul would throw on "abc" and take "-5" or "12x"
+bool parseCount(const char* text, unsigned int& count) {
+    if (*text < '0' || *text > '9') return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value == 0 || value > std::numeric_limits<unsigned int>::max()) return false;
+    count = static_cast<unsigned int>(value);
+    return true;
+}
+
+int main (int argc, char* argv[]) {
     srand(time(NULL));
+    initializeObbKernel();
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        unsigned int count = 100000;
+        if (argc > 2 && !parseCount(argv[2], count)) {
+            std::cout << "usage: hw02.1 [--bench [boxes]]\n";
+            return 1;
+        }
+        return runBenchmark(count);
+    }
+
     sf::RenderWindow window(sf::VideoMode(window_w, window_h), "HW02.1");
 	window.setFramerateLimit(fps_limit);
 
     initializeSettings();
     
+    snapshotBoxes();
+    FixedTimestep timestep(fixed_update_time, max_substeps);
     sf::Clock clock;
-    sf::Time timeSinceLastUpdate;
     while(window.isOpen()) {
-        sf::Time elapsed = clock.restart();
-        timeSinceLastUpdate += elapsed;
-
         handleInput(window);
-        while (timeSinceLastUpdate >= fixed_update_time) {
+        // only the state before the frame's last step is needed for blending
+        for (unsigned int steps = timestep.advance(clock.restart()); steps > 0; --steps) {
+            if (steps == 1) {
+                snapshotBoxes();
+            }
             update(fixed_update_time, window);
-            timeSinceLastUpdate -= fixed_update_time;
         }
-        render(window);
+        render(window, timestep.alpha());
     }
     return 0;
 }
\ No newline at end of file
@@ -4,7 +4,15 @@
 #include <fstream>
 #include <vector>
 #include <limits>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <unordered_set>
+#include <iomanip>
+#include <string>
+#include <map>
 #include <SFML/Graphics.hpp>
+#include "fixed_timestep.hpp"
 
 namespace utility {
     // in case the person compiling this does not have C++17 installed
@@ -21,6 +29,7 @@ namespace utility {
 constexpr unsigned int fps_limit{255};
 constexpr float epsilon{1e-6f};
 const sf::Time fixed_update_time = sf::seconds(1.f/fps_limit);
+constexpr unsigned int max_substeps{16};
 const sf::Vector2f zero_vector{0.f,0.f};
 const sf::Vector2f limit_vector{std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
 constexpr float pi{std::acos(-1)};
@@ -66,9 +75,305 @@ sf::Vector2<T> vectorRotate(const sf::Vector2<T>& a, float cos, float sin) {
     return sf::Vector2<T>{a.x*cos - a.y*sin, a.x*sin + a.y*cos};
 }
 
+// dynamic AABB tree broadphase (same scheme as Box2D's b2DynamicTree)
+// every polygon is a leaf holding a fattened copy of its bounding box; a polygon only goes back into the tree
+// when its tight box leaves the fat one, and the tree keeps itself balanced with rotations on the way up
+constexpr float aabb_margin{10.f};
+constexpr int null_node{-1};
+
+struct AABB {
+    sf::Vector2f lo;
+    sf::Vector2f hi;
+
+    // same strict test as sf::FloatRect::intersects
+    bool overlaps(const AABB& o) const {
+        return lo.x < o.hi.x && o.lo.x < hi.x && lo.y < o.hi.y && o.lo.y < hi.y;
+    }
+
+    bool contains(const AABB& o) const {
+        return lo.x <= o.lo.x && lo.y <= o.lo.y && o.hi.x <= hi.x && o.hi.y <= hi.y;
+    }
+
+    float perimeter() const {
+        return 2.f * ((hi.x - lo.x) + (hi.y - lo.y));
+    }
+
+    static AABB combine(const AABB& a, const AABB& b) {
+        return {{std::min(a.lo.x, b.lo.x), std::min(a.lo.y, b.lo.y)}, {std::max(a.hi.x, b.hi.x), std::max(a.hi.y, b.hi.y)}};
+    }
+};
+
+struct TreeNode {
+    AABB box;
+    int parent{null_node}; // next free node while on the free list
+    int child1{null_node};
+    int child2{null_node};
+    int height{-1};        // 0 for leaves, -1 while free
+    unsigned int poly{0};
+
+    bool isLeaf() const {
+        return child1 == null_node;
+    }
+};
+
+struct AABBTree {
+    std::vector<TreeNode> nodes;
+    int root{null_node};
+    int freeList{null_node};
+    std::vector<int> stack;
+
+    int allocateNode() {
+        if (freeList == null_node) {
+            nodes.emplace_back();
+            return nodes.size() - 1;
+        }
+        int node = freeList;
+        freeList = nodes[node].parent;
+        nodes[node] = TreeNode();
+        return node;
+    }
+
+    void freeNode(int node) {
+        nodes[node].parent = freeList;
+        nodes[node].height = -1;
+        freeList = node;
+    }
+
+    int createProxy(const AABB& tight, unsigned int poly, float margin = aabb_margin) {
+        int proxy = allocateNode();
+        nodes[proxy].box = {tight.lo - sf::Vector2f(margin, margin), tight.hi + sf::Vector2f(margin, margin)};
+        nodes[proxy].poly = poly;
+        nodes[proxy].height = 0;
+        insertLeaf(proxy);
+        return proxy;
+    }
+
+    // returns true when the proxy had to be reinserted
+    bool moveProxy(int proxy, const AABB& tight) {
+        if (nodes[proxy].box.contains(tight)) {
+            return false;
+        }
+        removeLeaf(proxy);
+        nodes[proxy].box = {tight.lo - sf::Vector2f(aabb_margin, aabb_margin), tight.hi + sf::Vector2f(aabb_margin, aabb_margin)};
+        insertLeaf(proxy);
+        return true;
+    }
+
+    void insertLeaf(int leaf) {
+        if (root == null_node) {
+            root = leaf;
+            nodes[root].parent = null_node;
+            return;
+        }
+
+        // find the cheapest sibling by the perimeter heuristic
+        AABB leafBox = nodes[leaf].box;
+        int index = root;
+        while (!nodes[index].isLeaf()) {
+            const TreeNode& node = nodes[index];
+            float area = node.box.perimeter();
+            float combinedArea = AABB::combine(node.box, leafBox).perimeter();
+            float cost = 2.f * combinedArea;
+            float inheritanceCost = 2.f * (combinedArea - area);
+
+            auto descendCost = [&](int child) {
+                float enlarged = AABB::combine(leafBox, nodes[child].box).perimeter();
+                return (nodes[child].isLeaf() ? enlarged : enlarged - nodes[child].box.perimeter()) + inheritanceCost;
+            };
+            float cost1 = descendCost(node.child1);
+            float cost2 = descendCost(node.child2);
+            if (cost < cost1 && cost < cost2) {
+                break;
+            }
+            index = cost1 < cost2 ? node.child1 : node.child2;
+        }
+
+        int sibling = index;
+        int oldParent = nodes[sibling].parent;
+        int newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].box = AABB::combine(leafBox, nodes[sibling].box);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        if (oldParent == null_node) {
+            root = newParent;
+        } else if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+
+        refitUpwards(nodes[leaf].parent);
+    }
+
+    void removeLeaf(int leaf) {
+        if (leaf == root) {
+            root = null_node;
+            return;
+        }
+
+        int parent = nodes[leaf].parent;
+        int grandParent = nodes[parent].parent;
+        int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+        if (grandParent == null_node) {
+            root = sibling;
+            nodes[sibling].parent = null_node;
+            freeNode(parent);
+            return;
+        }
+
+        if (nodes[grandParent].child1 == parent) {
+            nodes[grandParent].child1 = sibling;
+        } else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+        refitUpwards(grandParent);
+    }
+
+    void refitUpwards(int index) {
+        while (index != null_node) {
+            index = balance(index);
+            TreeNode& node = nodes[index];
+            node.height = 1 + std::max(nodes[node.child1].height, nodes[node.child2].height);
+            node.box = AABB::combine(nodes[node.child1].box, nodes[node.child2].box);
+            index = node.parent;
+        }
+    }
+
+    void replaceChild(int parent, int oldChild, int newChild) {
+        if (parent == null_node) {
+            root = newChild;
+        } else if (nodes[parent].child1 == oldChild) {
+            nodes[parent].child1 = newChild;
+        } else {
+            nodes[parent].child2 = newChild;
+        }
+    }
+
+    // rotates the taller grandchild up when the children of a differ in height by more than one
+    // returns the node now standing where a was
+    int balance(int iA) {
+        TreeNode& A = nodes[iA];
+        if (A.isLeaf() || A.height < 2) {
+            return iA;
+        }
+
+        int iB = A.child1;
+        int iC = A.child2;
+        TreeNode& B = nodes[iB];
+        TreeNode& C = nodes[iC];
+        int heightDifference = C.height - B.height;
+
+        if (heightDifference > 1) {
+            int iF = C.child1;
+            int iG = C.child2;
+            TreeNode& F = nodes[iF];
+            TreeNode& G = nodes[iG];
+            C.child1 = iA;
+            C.parent = A.parent;
+            A.parent = iC;
+            replaceChild(C.parent, iA, iC);
+            if (F.height > G.height) {
+                C.child2 = iF;
+                A.child2 = iG;
+                G.parent = iA;
+                A.box = AABB::combine(B.box, G.box);
+                C.box = AABB::combine(A.box, F.box);
+                A.height = 1 + std::max(B.height, G.height);
+                C.height = 1 + std::max(A.height, F.height);
+            } else {
+                C.child2 = iG;
+                A.child2 = iF;
+                F.parent = iA;
+                A.box = AABB::combine(B.box, F.box);
+                C.box = AABB::combine(A.box, G.box);
+                A.height = 1 + std::max(B.height, F.height);
+                C.height = 1 + std::max(A.height, G.height);
+            }
+            return iC;
+        }
+
+        if (heightDifference < -1) {
+            int iD = B.child1;
+            int iE = B.child2;
+            TreeNode& D = nodes[iD];
+            TreeNode& E = nodes[iE];
+            B.child1 = iA;
+            B.parent = A.parent;
+            A.parent = iB;
+            replaceChild(B.parent, iA, iB);
+            if (D.height > E.height) {
+                B.child2 = iD;
+                A.child1 = iE;
+                E.parent = iA;
+                A.box = AABB::combine(C.box, E.box);
+                B.box = AABB::combine(A.box, D.box);
+                A.height = 1 + std::max(C.height, E.height);
+                B.height = 1 + std::max(A.height, D.height);
+            } else {
+                B.child2 = iE;
+                A.child1 = iD;
+                D.parent = iA;
+                A.box = AABB::combine(C.box, D.box);
+                B.box = AABB::combine(A.box, E.box);
+                A.height = 1 + std::max(C.height, D.height);
+                B.height = 1 + std::max(A.height, E.height);
+            }
+            return iB;
+        }
+
+        return iA;
+    }
+
+    // calls fn(poly) for every leaf whose fat box overlaps box
+    template <typename F>
+    void query(const AABB& box, F&& fn) {
+        if (root == null_node) return;
+        stack.clear();
+        stack.push_back(root);
+        while (!stack.empty()) {
+            int index = stack.back();
+            stack.pop_back();
+            const TreeNode& node = nodes[index];
+            if (!node.box.overlaps(box)) continue;
+            if (node.isLeaf()) {
+                fn(node.poly);
+            } else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+};
+
 // enumerations
 enum Direction {up, down, left, right};
 
+// a polygon in the world: which shared prototype it uses plus its own placement
+// the accessors follow sf::Transformable so moving a polygon reads the same as moving a shape
+struct PolyInstance {
+    unsigned int prototype{0};
+    sf::Vector2f position;
+    float rotation{0.f};
+
+    const sf::Vector2f& getPosition() const { return position; }
+    void setPosition(const sf::Vector2f& p) { position = p; }
+    void setPosition(float x, float y) { position = sf::Vector2f(x, y); }
+    void move(const sf::Vector2f& offset) { position += offset; }
+    float getRotation() const { return rotation; }
+    void setRotation(float angle) {
+        rotation = std::fmod(angle, 360.f);
+        if (rotation < 0.f) rotation += 360.f;
+    }
+    void rotate(float angle) { setRotation(rotation + angle); }
+    sf::Transform getTransform() const { return sf::Transform().translate(position).rotate(rotation); }
+};
+
 // globals
 unsigned int window_w{default_vals::window_w};
 unsigned int window_h{default_vals::window_h};
@@ -78,79 +383,1061 @@ float speed{default_vals::speed};
 bool directionFlags[4] = {false, false, false, false};
 bool leftMouseButtonFlag = false;
 bool spaceButtonFlag = false;
+bool pushApartFlag = false;
+bool collisionStatsFlag = false;
 
-std::vector<sf::ConvexShape> polys;
-std::vector<sf::RectangleShape> boundingBoxEntity;
+std::vector<PolyInstance> polys;
 std::vector<sf::FloatRect> boundingBoxValues;
 std::vector<sf::Vector2f> rectSizes;
 std::vector<float> rotation_speed;
 
-bool SAT (sf::ConvexShape a, sf::ConvexShape b) 
-{
-    float rota = a.getRotation() * deg_to_rad;
-    float cosa = cos(rota);
-    float sina = sin(rota);
-    float rotb = b.getRotation() * deg_to_rad;
-    float cosb = cos(rotb);
-    float sinb = sin(rotb);
-
-    int an = a.getPointCount();
-    int bn = b.getPointCount();
-
-    // get all axes
-    sf::Vector2f axes[an + bn], p0, p1;
-    for (int i = 0; i < an; i++) 
-    {
-        p0 = vectorRotate(a.getPoint(i), cosa, sina);
-        p1 = vectorRotate(a.getPoint((i+1)%an), cosa, sina);
-        axes[i] = perp(p1 - p0);
-    }
-
-    for (int i = 0; i < bn; i++) 
-    {
-        p0 = vectorRotate(b.getPoint(i), cosb, sinb);
-        p1 = vectorRotate(b.getPoint((i+1)%bn), cosb, sinb);
-        axes[i + an] = perp(p1 - p0);
-    }
-
-    // project the polygon onto the axis
-    float amin, amax, bmin, bmax, ca, cb, ra, rb, t;
-    sf::Vector2f naxis;
-    for (int i = 0; i < an + bn; ++i) 
-    {
-        naxis = axes[i];
-        amin = amax = dot(naxis, vectorRotate(a.getPoint(0), cosa, sina) + a.getPosition());
-        bmin = bmax = dot(naxis, vectorRotate(b.getPoint(0), cosb, sinb) + b.getPosition());
-
-        for (int j = 1; j < an; ++j) 
-        {
-            t = dot(naxis, vectorRotate(a.getPoint(j), cosa, sina) + a.getPosition());
-            amin = std::min(amin, t); amax = std::max(amax, t);
-        }   
-        for (int j = 1; j < bn; ++j) 
-        {
-            t = dot(naxis, vectorRotate(b.getPoint(j), cosb, sinb) + b.getPosition());
-            bmin = std::min(bmin, t); bmax = std::max(bmax, t);
-        }
-
-        ca = (amin + amax) / 2.f;
-        cb = (bmin + bmax) / 2.f;
-        ra = (amax - amin) / 2.f;
-        rb = (bmax - bmin) / 2.f;
-
-        // if the distance of the centers are farther than the sum of their radius, they are separated
-        if (std::abs(cb-ca) > ra+rb) 
-        {
+// static bodies never move and sit in their own tree, built once with tight boxes, so static pairs are never
+// looked at. kinematic bodies are moved by the program (the space rotation), dynamic ones by input and, with P on,
+// by contacts; both live in the fat-box tree and only they query for pairs
+enum class BodyType {staticBody, kinematic, dynamic};
+
+AABBTree tree;
+AABBTree staticTree;
+std::vector<BodyType> bodyType;
+std::vector<unsigned int> movers;
+std::vector<int> polyProxy; // node in tree or staticTree, depending on the body type
+std::vector<unsigned int> moveBuffer;
+std::vector<unsigned int> touched; // polygons whose hit flags were set last step
+// overlaps between two static bodies cannot change, so they are found once when the world is rebuilt
+std::vector<unsigned char> staticAabbHit;
+std::vector<unsigned char> staticSatHit;
+bool worldDirty{true};
+std::vector<std::pair<unsigned int, unsigned int>> candidatePairs;
+std::unordered_set<unsigned long long> candidateKeys;
+std::vector<unsigned char> aabbHit;
+std::vector<unsigned char> satHit;
+// polygons whose placement, bounds or hit flags changed since the last rendered frame, however many steps ran
+std::vector<unsigned int> changedPolys;
+std::vector<unsigned char> changedMark;
+bool changedAll{true};
+
+void markChanged(unsigned int i) {
+    if (!changedMark[i]) {
+        changedMark[i] = 1;
+        changedPolys.push_back(i);
+    }
+}
+
+// mover placements and bounds before the latest fixed step, so a frame can be drawn between the last two steps;
+// every other polygon holds still and is drawn where it is
+std::vector<PolyInstance> previousPolys;
+std::vector<sf::FloatRect> previousBounds;
+
+void snapshotMovers() {
+    for (unsigned int m : movers) {
+        previousPolys[m] = polys[m];
+        previousBounds[m] = boundingBoxValues[m];
+    }
+}
+
+unsigned long long pairKey(unsigned int a, unsigned int b) {
+    return a < b ? (static_cast<unsigned long long>(a) << 32) | b : (static_cast<unsigned long long>(b) << 32) | a;
+}
+
+// one convex piece of a prototype in local space: counter-clockwise (positive signed area), no duplicate or
+// collinear points, with the outward unit edge normals, centroid and bounding radius around that centroid
+// normals[i] belongs to the edge from vertices[i] to vertices[i+1]
+struct ConvexPiece {
+    std::vector<sf::Vector2f> vertices;
+    std::vector<sf::Vector2f> normals;
+    sf::Vector2f centroid;
+    float radius{0.f};
+};
+
+// node of a prototype's piece hierarchy; children are always stored after their parent, so walking the nodes
+// backwards refits the bounds from the leaves up
+struct PieceNode {
+    int child1{null_node};
+    int child2{null_node};
+    unsigned int piece{0};
+
+    bool isLeaf() const {
+        return child1 == null_node;
+    }
+};
+
+// how a loaded point list became collision geometry
+enum class Outline {convex, decomposed, hull};
+
+// local-space polygon shared by every polygon with the same points, built once at load: the cleaned outline,
+// its convex pieces (just one unless the outline is concave) under a bounding hierarchy, and the triangle corners
+// that draw its fill and border
+struct PolyShape {
+    std::vector<sf::Vector2f> outline;
+    std::vector<ConvexPiece> pieces;
+    std::vector<PieceNode> hierarchy;
+    Outline kind{Outline::convex};
+    std::vector<sf::Vector2f> fill;
+    std::vector<sf::Vector2f> border;
+};
+
+struct VerticesLess {
+    bool operator()(const std::vector<sf::Vector2f>& a, const std::vector<sf::Vector2f>& b) const {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+            [](const sf::Vector2f& p, const sf::Vector2f& q) { return p.x < q.x || (p.x == q.x && p.y < q.y); });
+    }
+};
+
+std::vector<PolyShape> prototypes;
+std::map<std::vector<sf::Vector2f>, unsigned int, VerticesLess> prototypeIds;
+
+// 1 for a left (counter-clockwise) turn o -> a -> b, -1 for a right turn and 0 when the three are on a line
+// the tolerance is relative so it does not depend on the polygon size
+int turnDirection(const sf::Vector2f& o, const sf::Vector2f& a, const sf::Vector2f& b) {
+    sf::Vector2f u = a - o, v = b - a;
+    float c = cross(u, v);
+    float tolerance = epsilon * norm(u) * norm(v);
+    return c > tolerance ? 1 : c < -tolerance ? -1 : 0;
+}
+
+// replaces points with their convex hull (Andrew's monotone chain) in counter-clockwise order, dropping
+// duplicate and collinear points; returns false if fewer than 3 points are left
+bool convexHull(std::vector<sf::Vector2f>& points) {
+    std::sort(points.begin(), points.end(), [](const sf::Vector2f& a, const sf::Vector2f& b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    unsigned int n = points.size();
+    if (n < 3) {
+        return false;
+    }
+
+    std::vector<sf::Vector2f> hull(2 * n);
+    unsigned int k = 0;
+    for (unsigned int i = 0; i < n; ++i) {
+        while (k >= 2 && turnDirection(hull[k-2], hull[k-1], points[i]) != 1) --k;
+        hull[k++] = points[i];
+    }
+    for (unsigned int i = n - 1, lower = k + 1; i-- > 0;) {
+        while (k >= lower && turnDirection(hull[k-2], hull[k-1], points[i]) != 1) --k;
+        hull[k++] = points[i];
+    }
+    hull.resize(k - 1);
+    points.swap(hull);
+    return points.size() >= 3;
+}
+
+// drops repeated points and points that sit on a line (or a zero-width spike) between their neighbours, then
+// turns the ring counter-clockwise and starts it at its lowest point, so the same outline listed from another
+// vertex or in the other winding comes out identical; returns false if fewer than 3 points are left
+bool cleanRing(std::vector<sf::Vector2f>& ring) {
+    for (bool changed = true; changed && ring.size() >= 3;) {
+        changed = false;
+        for (unsigned int j = 0; j < ring.size() && ring.size() >= 3;) {
+            unsigned int n = ring.size();
+            if (turnDirection(ring[(j+n-1)%n], ring[j], ring[(j+1)%n]) == 0) {
+                ring.erase(ring.begin() + j);
+                changed = true;
+            } else {
+                ++j;
+            }
+        }
+    }
+    if (ring.size() < 3) {
+        return false;
+    }
+    float twiceArea = 0.f;
+    for (unsigned int j = 0; j < ring.size(); ++j) {
+        twiceArea += cross(ring[j], ring[(j+1)%ring.size()]);
+    }
+    if (twiceArea < 0.f) {
+        std::reverse(ring.begin(), ring.end());
+    }
+    std::rotate(ring.begin(), std::min_element(ring.begin(), ring.end(), [](const sf::Vector2f& a, const sf::Vector2f& b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    }), ring.end());
+    return true;
+}
+
+// a counter-clockwise ring that only turns left and goes around once
+bool isConvexRing(const std::vector<sf::Vector2f>& ring) {
+    unsigned int n = ring.size();
+    float turning = 0.f;
+    for (unsigned int j = 0; j < n; ++j) {
+        const sf::Vector2f& a = ring[j];
+        const sf::Vector2f& b = ring[(j+1)%n];
+        const sf::Vector2f& c = ring[(j+2)%n];
+        if (turnDirection(a, b, c) != 1) {
+            return false;
+        }
+        turning += std::atan2(cross(b - a, c - b), dot(b - a, c - b));
+    }
+    // a star drawn in one stroke turns left everywhere but winds around twice
+    return turning < 3.f * pi;
+}
+
+// closed segments pq and rs share at least one point
+bool segmentsTouch(const sf::Vector2f& p, const sf::Vector2f& q, const sf::Vector2f& r, const sf::Vector2f& s) {
+    float d1 = cross(q - p, r - p), d2 = cross(q - p, s - p);
+    float d3 = cross(s - r, p - r), d4 = cross(s - r, q - r);
+    if (((d1 > 0.f && d2 < 0.f) || (d1 < 0.f && d2 > 0.f)) && ((d3 > 0.f && d4 < 0.f) || (d3 < 0.f && d4 > 0.f))) {
+        return true;
+    }
+    auto onSegment = [](const sf::Vector2f& a, const sf::Vector2f& b, const sf::Vector2f& c) {
+        return std::min(a.x, b.x) <= c.x && c.x <= std::max(a.x, b.x) && std::min(a.y, b.y) <= c.y && c.y <= std::max(a.y, b.y);
+    };
+    return (d1 == 0.f && onSegment(p, q, r)) || (d2 == 0.f && onSegment(p, q, s)) ||
+           (d3 == 0.f && onSegment(r, s, p)) || (d4 == 0.f && onSegment(r, s, q));
+}
+
+// no two edges that are not neighbours cross or touch; O(n^2), so it only runs once per prototype at load
+bool isSimpleRing(const std::vector<sf::Vector2f>& ring) {
+    unsigned int n = ring.size();
+    for (unsigned int i = 0; i < n; ++i) {
+        for (unsigned int j = i + 2; j < n; ++j) {
+            if (i == 0 && j == n - 1) continue;
+            if (segmentsTouch(ring[i], ring[i+1], ring[j], ring[(j+1)%n])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// ear clipping over a counter-clockwise simple ring; returns false if rounding leaves it without an ear
+bool triangulate(const std::vector<sf::Vector2f>& ring, std::vector<std::vector<unsigned int>>& triangles) {
+    std::vector<unsigned int> remaining(ring.size());
+    for (unsigned int j = 0; j < ring.size(); ++j) remaining[j] = j;
+
+    auto inside = [&](const sf::Vector2f& p, unsigned int a, unsigned int b, unsigned int c) {
+        return cross(ring[b] - ring[a], p - ring[a]) >= 0.f && cross(ring[c] - ring[b], p - ring[b]) >= 0.f &&
+               cross(ring[a] - ring[c], p - ring[c]) >= 0.f;
+    };
+    unsigned int k = 0, misses = 0;
+    while (remaining.size() > 3) {
+        unsigned int m = remaining.size();
+        if (misses >= m) {
             return false;
         }
+        k %= m;
+        unsigned int a = remaining[(k+m-1)%m], b = remaining[k], c = remaining[(k+1)%m];
+        int turn = turnDirection(ring[a], ring[b], ring[c]);
+        bool ear = turn == 1;
+        for (unsigned int r = 0; ear && r < m; ++r) {
+            unsigned int v = remaining[r];
+            ear = v == a || v == b || v == c || !inside(ring[v], a, b, c);
+        }
+        if (ear || turn == 0) {
+            // a vertex left on the line between its neighbours adds no area, so it is dropped without a triangle
+            if (ear) triangles.push_back({a, b, c});
+            remaining.erase(remaining.begin() + k);
+            misses = 0;
+        } else {
+            ++k;
+            ++misses;
+        }
+    }
+    if (turnDirection(ring[remaining[0]], ring[remaining[1]], ring[remaining[2]]) == 1) {
+        triangles.push_back(remaining);
     }
     return true;
 }
 
+// Hertel-Mehlhorn: starting from the triangles, every diagonal is removed if the two pieces on either side of it
+// merge into a convex piece; this leaves at most four times the optimal number of pieces
+std::vector<std::vector<unsigned int>> mergeConvexPieces(const std::vector<sf::Vector2f>& ring, std::vector<std::vector<unsigned int>> pieces) {
+    std::map<std::pair<unsigned int, unsigned int>, unsigned int> owner;
+    std::vector<std::pair<unsigned int, unsigned int>> diagonals;
+    for (unsigned int p = 0; p < pieces.size(); ++p) {
+        for (unsigned int k = 0; k < 3; ++k) {
+            owner[{pieces[p][k], pieces[p][(k+1)%3]}] = p;
+        }
+    }
+    for (const auto& edge : owner) {
+        if (edge.first.first < edge.first.second && owner.count({edge.first.second, edge.first.first})) {
+            diagonals.push_back(edge.first);
+        }
+    }
+
+    for (const auto& diagonal : diagonals) {
+        unsigned int u = diagonal.first, v = diagonal.second;
+        unsigned int pa = owner[{u, v}], pb = owner[{v, u}];
+        std::vector<unsigned int>& A = pieces[pa];
+        std::vector<unsigned int>& B = pieces[pb];
+        unsigned int na = A.size(), nb = B.size();
+        unsigned int ia = std::find(A.begin(), A.end(), u) - A.begin();
+        unsigned int ib = std::find(B.begin(), B.end(), v) - B.begin();
+        // corners of the merged piece at both ends of the diagonal
+        if (turnDirection(ring[A[(ia+na-1)%na]], ring[u], ring[B[(ib+2)%nb]]) != 1 ||
+            turnDirection(ring[B[(ib+nb-1)%nb]], ring[v], ring[A[(ia+2)%na]]) != 1) {
+            continue;
+        }
+        std::vector<unsigned int> merged;
+        for (unsigned int k = 1; k <= na; ++k) merged.push_back(A[(ia+k)%na]);
+        for (unsigned int k = 2; k < nb; ++k) merged.push_back(B[(ib+k)%nb]);
+        owner.erase({u, v});
+        owner.erase({v, u});
+        for (unsigned int k = 0; k < merged.size(); ++k) {
+            auto edge = owner.find({merged[k], merged[(k+1)%merged.size()]});
+            if (edge != owner.end()) edge->second = pa;
+        }
+        A.swap(merged);
+        B.clear();
+    }
+    pieces.erase(std::remove_if(pieces.begin(), pieces.end(), [](const std::vector<unsigned int>& p) { return p.empty(); }), pieces.end());
+    return pieces;
+}
+
+ConvexPiece makePiece(const std::vector<sf::Vector2f>& points) {
+    ConvexPiece piece;
+    unsigned int n = points.size();
+    piece.vertices = points;
+    piece.normals.resize(n);
+    // area-weighted centroid of the triangle fan
+    float twiceArea = 0.f;
+    sf::Vector2f centroid = zero_vector;
+    for (unsigned int j = 0; j < n; ++j) {
+        const sf::Vector2f& a = points[j];
+        const sf::Vector2f& b = points[(j+1)%n];
+        sf::Vector2f edge = b - a;
+        // the ring is counter-clockwise, so the outward normal is the clockwise perpendicular
+        piece.normals[j] = -perp(edge) / norm(edge);
+        float c = cross(a, b);
+        twiceArea += c;
+        centroid += (a + b) * c;
+    }
+    piece.centroid = centroid / (3.f * twiceArea);
+    for (const sf::Vector2f& v : points) {
+        piece.radius = std::max(piece.radius, norm(v - piece.centroid));
+    }
+    return piece;
+}
+
+// median split of the pieces by centroid along the wider spread; returns the subtree's root
+int buildPieceHierarchy(PolyShape& shape, std::vector<unsigned int>& ids, unsigned int begin, unsigned int end) {
+    int node = shape.hierarchy.size();
+    shape.hierarchy.emplace_back();
+    if (end - begin == 1) {
+        shape.hierarchy[node].piece = ids[begin];
+        return node;
+    }
+    sf::Vector2f lo = limit_vector, hi = -limit_vector;
+    for (unsigned int k = begin; k < end; ++k) {
+        const sf::Vector2f& c = shape.pieces[ids[k]].centroid;
+        lo = sf::Vector2f(std::min(lo.x, c.x), std::min(lo.y, c.y));
+        hi = sf::Vector2f(std::max(hi.x, c.x), std::max(hi.y, c.y));
+    }
+    bool alongX = hi.x - lo.x >= hi.y - lo.y;
+    unsigned int middle = (begin + end) / 2;
+    std::nth_element(ids.begin() + begin, ids.begin() + middle, ids.begin() + end, [&](unsigned int a, unsigned int b) {
+        const sf::Vector2f& ca = shape.pieces[a].centroid;
+        const sf::Vector2f& cb = shape.pieces[b].centroid;
+        return alongX ? ca.x < cb.x : ca.y < cb.y;
+    });
+    int child1 = buildPieceHierarchy(shape, ids, begin, middle);
+    int child2 = buildPieceHierarchy(shape, ids, middle, end);
+    shape.hierarchy[node].child1 = child1;
+    shape.hierarchy[node].child2 = child2;
+    return node;
+}
+
+// fill triangles for every piece, and border quads mitred outward from the outline like sf::Shape's outline
+void buildDrawables(PolyShape& shape, float thickness) {
+    shape.fill.clear();
+    for (const ConvexPiece& piece : shape.pieces) {
+        for (unsigned int j = 1; j + 1 < piece.vertices.size(); ++j) {
+            shape.fill.insert(shape.fill.end(), {piece.vertices[0], piece.vertices[j], piece.vertices[j+1]});
+        }
+    }
+    const std::vector<sf::Vector2f>& ring = shape.outline;
+    unsigned int n = ring.size();
+    std::vector<sf::Vector2f> outer(n);
+    for (unsigned int j = 0; j < n; ++j) {
+        const sf::Vector2f& prev = ring[(j+n-1)%n];
+        const sf::Vector2f& p = ring[j];
+        const sf::Vector2f& next = ring[(j+1)%n];
+        sf::Vector2f n1 = -perp(p - prev) / norm(p - prev);
+        sf::Vector2f n2 = -perp(next - p) / norm(next - p);
+        outer[j] = p + (n1 + n2) * (thickness / (1.f + dot(n1, n2)));
+    }
+    shape.border.clear();
+    for (unsigned int j = 0; j < n; ++j) {
+        unsigned int k = (j+1)%n;
+        shape.border.insert(shape.border.end(), {ring[j], ring[k], outer[k], ring[j], outer[k], outer[j]});
+    }
+}
+
+// cleans points into an outline and returns its prototype, adding one if no polygon has used that outline yet
+// convex outlines are one piece, concave ones are split into convex pieces, and anything that is not a simple
+// polygon (crossing or touching itself, or too degenerate to clean) falls back to its convex hull
+unsigned int registerPrototype(std::vector<sf::Vector2f> points) {
+    std::vector<sf::Vector2f> ring = points;
+    Outline kind = Outline::convex;
+    if (!cleanRing(ring)) {
+        kind = Outline::hull;
+    } else if (!isConvexRing(ring)) {
+        kind = isSimpleRing(ring) ? Outline::decomposed : Outline::hull;
+    }
+    if (kind == Outline::hull) {
+        ring = points;
+        if (!convexHull(ring)) {
+            // a point or a line still gets a tiny triangle so every polygon stays collidable
+            sf::Vector2f p = ring.empty() ? zero_vector : ring[0];
+            ring = {p, p + sf::Vector2f(1.f, 0.f), p + sf::Vector2f(0.f, 1.f)};
+        }
+    }
+    auto found = prototypeIds.find(ring);
+    if (found != prototypeIds.end()) {
+        return found->second;
+    }
+
+    std::vector<std::vector<unsigned int>> triangles;
+    if (kind == Outline::decomposed && !triangulate(ring, triangles)) {
+        kind = Outline::hull;
+        if (!convexHull(ring)) {
+            sf::Vector2f p = ring[0];
+            ring = {p, p + sf::Vector2f(1.f, 0.f), p + sf::Vector2f(0.f, 1.f)};
+        }
+    }
+
+    unsigned int id = prototypes.size();
+    prototypeIds.emplace(ring, id);
+    prototypes.emplace_back();
+    PolyShape& shape = prototypes.back();
+    shape.outline = ring;
+    shape.kind = kind;
+    if (kind == Outline::decomposed) {
+        for (const std::vector<unsigned int>& piece : mergeConvexPieces(ring, triangles)) {
+            std::vector<sf::Vector2f> vertices;
+            for (unsigned int v : piece) vertices.push_back(ring[v]);
+            shape.pieces.push_back(makePiece(vertices));
+        }
+    } else {
+        shape.pieces.push_back(makePiece(ring));
+    }
+    std::vector<unsigned int> ids(shape.pieces.size());
+    for (unsigned int k = 0; k < ids.size(); ++k) ids[k] = k;
+    buildPieceHierarchy(shape, ids, 0, ids.size());
+    buildDrawables(shape, 3.f);
+    return id;
+}
+
+// world-space vertices and outward unit edge normals of a convex piece, rebuilt only when its polygon moves
+// normals()[i] belongs to the edge from vertices[i] to vertices[i+1]; an unrotated piece reads its prototype's
+// normals by index and only a rotated one keeps its own copy, so copying a piece never leaves it pointing elsewhere
+// support queries (the vertex furthest along a direction) start from the vertex that answered the last query in
+// the same direction bucket, and fall back to a binary search over the ring, so large hulls cost O(log n)
+constexpr unsigned int support_hint_buckets{32};
+constexpr unsigned int support_climb_steps{4};
+constexpr unsigned int support_linear_below{16};
+
+struct PolyGeometry {
+    std::vector<sf::Vector2f> vertices;
+    std::vector<sf::Vector2f> rotatedNormals;
+    unsigned int prototype{0};
+    unsigned int piece{0};
+    bool rotated{false};
+    sf::Vector2f centroid;
+    float radius{0.f};
+    sf::FloatRect bounds;
+    mutable std::vector<unsigned int> supportHint; // one start vertex per direction bucket, only for large hulls
+
+    const std::vector<sf::Vector2f>& normals() const {
+        return rotated ? rotatedNormals : prototypes[prototype].pieces[piece].normals;
+    }
+};
+
+// a polygon's pieces in world space, with their bounds refit into the prototype's piece hierarchy
+// movers always keep their pieces; a static body only holds them while it is in some mover's candidate pair,
+// so the bulk of a large scene holds no per-instance vertices at all
+struct BodyGeometry {
+    std::vector<PolyGeometry> pieces;
+    std::vector<AABB> nodeBounds; // parallel to the prototype's hierarchy, empty for a single piece
+    unsigned int prototype{0};
+    sf::FloatRect bounds;
+    sf::Vector2f position;
+    float rotation{0.f};
+    bool valid{false};
+};
+
+std::vector<BodyGeometry> polyGeometry;
+std::vector<PolyGeometry> placedScratch; // a static body's pieces while its bounds are worked out
+
+// points the polygon at the prototype for its outline and reports how the points were used
+Outline setPolygon(unsigned int i, const std::vector<sf::Vector2f>& points) {
+    polys[i].prototype = registerPrototype(points);
+    polyGeometry[i].valid = false;
+    return prototypes[polys[i].prototype].kind;
+}
+
+// monotonic stand-in for atan2 in [0, 4)
+float diamondAngle(const sf::Vector2f& d) {
+    float sum = std::abs(d.x) + std::abs(d.y);
+    if (sum < epsilon) return 0.f;
+    float t = d.y / sum;
+    return d.x >= 0.f ? (d.y >= 0.f ? t : 4.f + t) : 2.f - t;
+}
+
+// dot(d, v[i]) goes up then down once around a convex ring, so the maximum can be bisected
+// (polyMax_2D from geomalgorithms.com); returns n if the ring is too degenerate to bisect
+unsigned int supportSearch(const std::vector<sf::Vector2f>& v, const sf::Vector2f& d) {
+    unsigned int n = v.size();
+    auto at = [&](unsigned int i) -> const sf::Vector2f& { return v[i % n]; };
+    auto rising = [&](unsigned int i) { return dot(d, at(i+1) - at(i)) > 0.f; };
+    auto above = [&](unsigned int i, unsigned int j) { return dot(d, at(i) - at(j)) > 0.f; };
+
+    unsigned int a = 0, b = n;
+    bool upA = rising(0);
+    if (!upA && !above(n-1, 0)) return 0;
+    while (b > a + 1) {
+        unsigned int c = (a + b) / 2;
+        bool upC = rising(c);
+        if (!upC && !above(c-1, c)) return c;
+        if (upA) {
+            if (!upC || above(a, c)) {
+                b = c;
+            } else {
+                a = c;
+                upA = upC;
+            }
+        } else {
+            if (!upC && above(c, a)) {
+                b = c;
+            } else {
+                a = c;
+                upA = upC;
+            }
+        }
+    }
+    return n;
+}
+
+unsigned int supportIndex(const PolyGeometry& g, const sf::Vector2f& d) {
+    const std::vector<sf::Vector2f>& v = g.vertices;
+    unsigned int n = v.size();
+    if (n >= support_linear_below) {
+        unsigned int& hint = g.supportHint[static_cast<unsigned int>(diamondAngle(d) * (support_hint_buckets / 4.f)) % support_hint_buckets];
+        // climb from the cached vertex; a coherent query is usually answered in a step or two
+        unsigned int best = hint < n ? hint : 0;
+        for (unsigned int step = 0; step < support_climb_steps; ++step) {
+            unsigned int next = best + 1 == n ? 0 : best + 1;
+            unsigned int prev = best == 0 ? n - 1 : best - 1;
+            float here = dot(d, v[best]);
+            if (dot(d, v[next]) > here) {
+                best = next;
+            } else if (dot(d, v[prev]) > here) {
+                best = prev;
+            } else {
+                hint = best;
+                return best;
+            }
+        }
+        best = supportSearch(v, d);
+        if (best < n) {
+            hint = best;
+            return best;
+        }
+    }
+
+    unsigned int best = 0;
+    float bestDot = dot(d, v[0]);
+    for (unsigned int j = 1; j < n; ++j) {
+        float t = dot(d, v[j]);
+        if (t > bestDot) {
+            bestDot = t;
+            best = j;
+        }
+    }
+    return best;
+}
+
+// the outline was split at load, so a step only rotates and translates the pieces (polygons are never scaled)
+void placePiece(PolyGeometry& g, unsigned int prototype, unsigned int piece, const sf::Transform& transform, float rotation) {
+    const ConvexPiece& local = prototypes[prototype].pieces[piece];
+    unsigned int n = local.vertices.size();
+    g.vertices.resize(n);
+    for (unsigned int j = 0; j < n; ++j) {
+        g.vertices[j] = transform.transformPoint(local.vertices[j]);
+    }
+    g.prototype = prototype;
+    g.piece = piece;
+    g.rotated = rotation != 0.f;
+    if (g.rotated) {
+        g.rotatedNormals.resize(n);
+        float c = std::cos(rotation * deg_to_rad);
+        float s = std::sin(rotation * deg_to_rad);
+        for (unsigned int j = 0; j < n; ++j) {
+            g.rotatedNormals[j] = vectorRotate(local.normals[j], c, s);
+        }
+    }
+    if (n >= support_linear_below) {
+        g.supportHint.resize(support_hint_buckets, 0);
+    }
+    g.centroid = transform.transformPoint(local.centroid);
+    g.radius = local.radius;
+
+    float minX = g.vertices[supportIndex(g, sf::Vector2f(-1.f, 0.f))].x;
+    float maxX = g.vertices[supportIndex(g, sf::Vector2f(1.f, 0.f))].x;
+    float minY = g.vertices[supportIndex(g, sf::Vector2f(0.f, -1.f))].y;
+    float maxY = g.vertices[supportIndex(g, sf::Vector2f(0.f, 1.f))].y;
+    g.bounds = sf::FloatRect(minX, minY, maxX - minX, maxY - minY);
+}
+
+// returns true when the cached geometry had to be rebuilt
+// also rebuilt when the body changes between keeping its pieces (a mover) and not (static)
+bool refreshGeometry(unsigned int i) {
+    const PolyInstance& shape = polys[i];
+    BodyGeometry& body = polyGeometry[i];
+    bool keepPieces = bodyType[i] != BodyType::staticBody;
+    if (body.valid && body.position == shape.getPosition() && body.rotation == shape.getRotation()
+        && body.pieces.empty() != keepPieces) {
+        return false;
+    }
+    body.valid = true;
+    body.position = shape.getPosition();
+    body.rotation = shape.getRotation();
+    body.prototype = shape.prototype;
+
+    const PolyShape& local = prototypes[shape.prototype];
+    sf::Transform transform = shape.getTransform();
+    std::vector<PolyGeometry>& pieces = keepPieces ? body.pieces : placedScratch;
+    pieces.resize(local.pieces.size());
+    for (unsigned int p = 0; p < local.pieces.size(); ++p) {
+        placePiece(pieces[p], shape.prototype, p, transform, body.rotation);
+    }
+    if (local.pieces.size() == 1) {
+        body.bounds = pieces[0].bounds;
+        std::vector<AABB>().swap(body.nodeBounds);
+    } else {
+        // children come after their parent, so walking backwards refits from the leaves up
+        body.nodeBounds.resize(local.hierarchy.size());
+        for (unsigned int k = local.hierarchy.size(); k-- > 0;) {
+            const PieceNode& node = local.hierarchy[k];
+            if (node.isLeaf()) {
+                const sf::FloatRect& r = pieces[node.piece].bounds;
+                body.nodeBounds[k] = {{r.left, r.top}, {r.left + r.width, r.top + r.height}};
+            } else {
+                body.nodeBounds[k] = AABB::combine(body.nodeBounds[node.child1], body.nodeBounds[node.child2]);
+            }
+        }
+        const AABB& root = body.nodeBounds[0];
+        body.bounds = sf::FloatRect(root.lo.x, root.lo.y, root.hi.x - root.lo.x, root.hi.y - root.lo.y);
+    }
+    if (!keepPieces) {
+        std::vector<PolyGeometry>().swap(body.pieces);
+    }
+    return true;
+}
+
+// one piece of a body in world space: the body's own copy when it holds one, otherwise (a static body outside
+// any candidate pair, as in the rebuild's static-static check) the prototype's piece placed into scratch, which
+// stays good until the next call with the same scratch
+const PolyGeometry& bodyPiece(const BodyGeometry& body, unsigned int piece, PolyGeometry& scratch) {
+    if (!body.pieces.empty()) {
+        return body.pieces[piece];
+    }
+    sf::Transform transform = sf::Transform().translate(body.position).rotate(body.rotation);
+    placePiece(scratch, body.prototype, piece, transform, body.rotation);
+    return scratch;
+}
+
+// candidate pairs holding each static body; its pieces are placed when the first pair arrives and freed when
+// the last one is dropped, so a static is placed once per visit instead of once per pair test
+std::vector<unsigned int> staticPairHolds;
+
+void holdStaticPieces(unsigned int i) {
+    if (bodyType[i] != BodyType::staticBody || staticPairHolds[i]++ > 0) return;
+    BodyGeometry& body = polyGeometry[i];
+    const PolyShape& local = prototypes[body.prototype];
+    sf::Transform transform = sf::Transform().translate(body.position).rotate(body.rotation);
+    body.pieces.resize(local.pieces.size());
+    for (unsigned int p = 0; p < local.pieces.size(); ++p) {
+        placePiece(body.pieces[p], body.prototype, p, transform, body.rotation);
+    }
+}
+
+void releaseStaticPieces(unsigned int i) {
+    if (bodyType[i] != BodyType::staticBody || --staticPairHolds[i] > 0) return;
+    std::vector<PolyGeometry>().swap(polyGeometry[i].pieces);
+}
+
+// result of a polygon pair test: normal points from a to b, and moving b by normal * depth separates them
+struct Manifold {
+    sf::Vector2f normal;
+    float depth{0.f};
+    sf::Vector2f points[2];
+    unsigned int pointCount{0};
+};
+
+// the edge that last separated a pair; pairs are almost always separated by the same edge on the next step,
+// so it is tried before the full sweep. owner 0 means the edge belongs to a, 1 means b
+struct SeparatingAxis {
+    unsigned int edge{0};
+    unsigned char owner{0};
+    bool valid{false};
+};
+
+unsigned long long satTests{0};
+unsigned long long satCacheLookups{0};
+unsigned long long satCacheHits{0};
+
+// signed distance from edge i of a to the deepest vertex of b (positive means separated)
+float separationAlong(const PolyGeometry& a, const PolyGeometry& b, unsigned int i) {
+    const sf::Vector2f& n = a.normals()[i];
+    return dot(n, b.vertices[supportIndex(b, -n)] - a.vertices[i]);
+}
+
+// largest separation over the edges of a
+// stops at the first separating edge since nothing after it can change the answer
+float maxSeparation(const PolyGeometry& a, const PolyGeometry& b, unsigned int& edge) {
+    const std::vector<sf::Vector2f>& normals = a.normals();
+    float best = -std::numeric_limits<float>::max();
+    for (unsigned int i = 0; i < a.vertices.size(); ++i) {
+        float s = dot(normals[i], b.vertices[supportIndex(b, -normals[i])] - a.vertices[i]);
+        if (s > best) {
+            best = s;
+            edge = i;
+            if (best > 0.f) break;
+        }
+    }
+    return best;
+}
+
+// keeps the part of the segment in[0]-in[1] behind the line dot(normal, p) = offset
+unsigned int clipSegment(sf::Vector2f out[2], const sf::Vector2f in[2], const sf::Vector2f& normal, float offset) {
+    unsigned int count = 0;
+    float d0 = dot(normal, in[0]) - offset;
+    float d1 = dot(normal, in[1]) - offset;
+    if (d0 <= 0.f) out[count++] = in[0];
+    if (d1 <= 0.f) out[count++] = in[1];
+    if (d0 * d1 < 0.f) {
+        out[count++] = in[0] + (in[1] - in[0]) * (d0 / (d0 - d1));
+    }
+    return count;
+}
+
+// fills the contact points by clipping the edge of inc most opposed to the reference edge against its side planes
+void clipContacts(const PolyGeometry& ref, unsigned int edge, const PolyGeometry& inc, Manifold& manifold) {
+    const sf::Vector2f& refNormal = ref.normals()[edge];
+    const std::vector<sf::Vector2f>& incNormals = inc.normals();
+
+    unsigned int incEdge = 0;
+    float minDot = std::numeric_limits<float>::max();
+    for (unsigned int i = 0; i < inc.vertices.size(); ++i) {
+        float d = dot(refNormal, incNormals[i]);
+        if (d < minDot) {
+            minDot = d;
+            incEdge = i;
+        }
+    }
+    sf::Vector2f incident[2] = {inc.vertices[incEdge], inc.vertices[(incEdge+1)%inc.vertices.size()]};
+
+    const sf::Vector2f& v1 = ref.vertices[edge];
+    const sf::Vector2f& v2 = ref.vertices[(edge+1)%ref.vertices.size()];
+    sf::Vector2f tangent = v2 - v1;
+    float length = norm(tangent);
+    tangent = length > epsilon ? tangent / length : zero_vector;
+
+    sf::Vector2f clipped1[3], clipped2[3];
+    unsigned int count = clipSegment(clipped1, incident, -tangent, -dot(tangent, v1));
+    count = count < 2 ? 0 : clipSegment(clipped2, clipped1, tangent, dot(tangent, v2));
+
+    manifold.pointCount = 0;
+    float front = dot(refNormal, v1);
+    for (unsigned int i = 0; i < count && i < 2; ++i) {
+        if (dot(refNormal, clipped2[i]) - front <= 0.f) {
+            manifold.points[manifold.pointCount++] = clipped2[i];
+        }
+    }
+    // clipping can lose everything on slivers; fall back to the deepest incident vertex
+    if (manifold.pointCount == 0) {
+        manifold.points[0] = dot(refNormal, incident[0]) < dot(refNormal, incident[1]) ? incident[0] : incident[1];
+        manifold.pointCount = 1;
+    }
+}
+
+// separating axis test that also fills the manifold when the polygons overlap
+// the axis of least penetration picks a reference edge, and the most opposed edge of the other polygon is clipped
+// against it to get up to two contact points
+// with a cache, the pair's last separating edge is checked first and the cache is updated with the new one
+bool SAT (const PolyGeometry& a, const PolyGeometry& b, Manifold& manifold, SeparatingAxis* cache = nullptr) {
+    ++satTests;
+    if (cache && cache->valid) {
+        ++satCacheLookups;
+        const PolyGeometry& owner = cache->owner == 0 ? a : b;
+        const PolyGeometry& other = cache->owner == 0 ? b : a;
+        if (cache->edge < owner.vertices.size() && separationAlong(owner, other, cache->edge) > 0.f) {
+            ++satCacheHits;
+            return false;
+        }
+    }
+
+    unsigned int edgeA = 0, edgeB = 0;
+    float separationA = maxSeparation(a, b, edgeA);
+    if (separationA > 0.f) {
+        if (cache) *cache = {edgeA, 0, true};
+        return false;
+    }
+    float separationB = maxSeparation(b, a, edgeB);
+    if (separationB > 0.f) {
+        if (cache) *cache = {edgeB, 1, true};
+        return false;
+    }
+    if (cache) cache->valid = false;
+
+    // the normal and depth always come from the true axis of least penetration, even when the tie-break below
+    // keeps a as the reference
+    manifold.normal = separationB > separationA ? -b.normals()[edgeB] : a.normals()[edgeA];
+    manifold.depth = -std::max(separationA, separationB);
+
+    // prefer a as the reference so near-ties do not flip between steps
+    if (separationB > separationA + 0.1f) {
+        clipContacts(b, edgeB, a, manifold);
+    } else {
+        clipContacts(a, edgeA, b, manifold);
+    }
+    return true;
+}
+
+
+std::vector<sf::Vector2f> epaPolytope;
+
+// edge whose outward normal is closest to d
+unsigned int supportEdge(const PolyGeometry& g, const sf::Vector2f& d) {
+    const std::vector<sf::Vector2f>& normals = g.normals();
+    unsigned int best = 0;
+    float bestDot = dot(d, normals[0]);
+    for (unsigned int i = 1; i < g.vertices.size(); ++i) {
+        float t = dot(d, normals[i]);
+        if (t > bestDot) {
+            bestDot = t;
+            best = i;
+        }
+    }
+    return best;
+}
+
+// GJK/EPA narrowphase for many-vertex polygons
+// GJK walks a simplex of the Minkowski difference a - b towards the origin, touching each polygon only through its
+// support function, and EPA grows the final triangle outwards until it finds the boundary face nearest the origin
+constexpr unsigned int gjk_max_iterations{64};
+// the Minkowski difference has at most as many edges as both polygons together
+constexpr unsigned int epa_extra_iterations{16};
+constexpr float epa_tolerance{1e-3f};
+// pairs with at least this many vertices between them go through GJK when the policy is automatic
+constexpr unsigned int gjk_min_vertices{48};
+
+enum class Narrowphase {automatic, sat, gjk};
+
+Narrowphase narrowphase{Narrowphase::automatic};
+unsigned long long gjkTests{0};
+
+sf::Vector2f minkowskiSupport(const PolyGeometry& a, const PolyGeometry& b, const sf::Vector2f& d) {
+    return a.vertices[supportIndex(a, d)] - b.vertices[supportIndex(b, -d)];
+}
+
+// (a x b) x c, the part of b perpendicular to a pointing the same way c does when a = c
+sf::Vector2f tripleProduct(const sf::Vector2f& a, const sf::Vector2f& b, const sf::Vector2f& c) {
+    return b * dot(a, c) - a * dot(b, c);
+}
+
+// shrinks the simplex to the feature nearest the origin and points d at it
+// returns true once the origin is enclosed (or lies on the simplex)
+bool updateSimplex(sf::Vector2f simplex[3], unsigned int& count, sf::Vector2f& d) {
+    const sf::Vector2f a = simplex[count - 1];
+    const sf::Vector2f ao = -a;
+    if (count == 2) {
+        const sf::Vector2f ab = simplex[0] - a;
+        d = tripleProduct(ab, ao, ab);
+        if (dot(d, d) < epsilon) {
+            // origin on the segment
+            return dot(ab, ao) >= 0.f && dot(ao, ao) <= dot(ab, ab);
+        }
+        return false;
+    }
+
+    const sf::Vector2f ab = simplex[1] - a;
+    const sf::Vector2f ac = simplex[0] - a;
+    sf::Vector2f abPerp = tripleProduct(ac, ab, ab);
+    sf::Vector2f acPerp = tripleProduct(ab, ac, ac);
+    if (dot(abPerp, ao) > 0.f) {
+        simplex[0] = simplex[1];
+        simplex[1] = a;
+        count = 2;
+        d = abPerp;
+        return false;
+    }
+    if (dot(acPerp, ao) > 0.f) {
+        simplex[1] = a;
+        count = 2;
+        d = acPerp;
+        return false;
+    }
+    return true;
+}
+
+bool GJK (const PolyGeometry& a, const PolyGeometry& b, Manifold& manifold) {
+    ++gjkTests;
+    sf::Vector2f simplex[3];
+    unsigned int count = 0;
+    sf::Vector2f d = b.vertices[0] - a.vertices[0];
+    if (dot(d, d) < epsilon) d = sf::Vector2f(1.f, 0.f);
+
+    simplex[count++] = minkowskiSupport(a, b, d);
+    d = -simplex[0];
+    bool enclosed = false;
+    for (unsigned int iteration = 0; iteration < gjk_max_iterations && !enclosed; ++iteration) {
+        if (dot(d, d) < epsilon) {
+            enclosed = true;
+            break;
+        }
+        sf::Vector2f p = minkowskiSupport(a, b, d);
+        if (dot(p, d) < 0.f) {
+            return false;
+        }
+        simplex[count++] = p;
+        enclosed = updateSimplex(simplex, count, d);
+    }
+
+    // touching or degenerate simplex: there is no area for EPA to expand, let SAT work out the contact
+    if (count < 3) {
+        return SAT(a, b, manifold);
+    }
+
+    std::vector<sf::Vector2f>& polytope = epaPolytope;
+    polytope.assign(simplex, simplex + 3);
+    if (cross(polytope[1] - polytope[0], polytope[2] - polytope[0]) < 0.f) {
+        std::swap(polytope[1], polytope[2]);
+    }
+
+    sf::Vector2f normal;
+    float depth = 0.f;
+    unsigned int epaIterations = a.vertices.size() + b.vertices.size() + epa_extra_iterations;
+    for (unsigned int iteration = 0; iteration < epaIterations; ++iteration) {
+        // edge nearest the origin; outward normals of a counter-clockwise ring are (e.y, -e.x)
+        unsigned int nearest = 0;
+        float nearestDistance = std::numeric_limits<float>::max();
+        for (unsigned int i = 0; i < polytope.size(); ++i) {
+            sf::Vector2f e = polytope[(i+1)%polytope.size()] - polytope[i];
+            float length = norm(e);
+            if (length < epsilon) continue;
+            sf::Vector2f n(e.y / length, -e.x / length);
+            float distance = dot(n, polytope[i]);
+            if (distance < nearestDistance) {
+                nearestDistance = distance;
+                nearest = i;
+                normal = n;
+            }
+        }
+        depth = nearestDistance;
+        sf::Vector2f p = minkowskiSupport(a, b, normal);
+        if (dot(p, normal) - nearestDistance < epa_tolerance) {
+            break;
+        }
+        polytope.insert(polytope.begin() + nearest + 1, p);
+    }
+
+    manifold.normal = normal;
+    manifold.depth = std::max(depth, 0.f);
+
+    // the reference edge is whichever face lines up best with the normal
+    unsigned int edgeA = supportEdge(a, normal);
+    unsigned int edgeB = supportEdge(b, -normal);
+    if (dot(b.normals()[edgeB], -normal) > dot(a.normals()[edgeA], normal) + epsilon) {
+        clipContacts(b, edgeB, a, manifold);
+    } else {
+        clipContacts(a, edgeA, b, manifold);
+    }
+    return true;
+}
+
+// SAT or GJK for a pair depending on the narrowphase policy
+bool collide(const PolyGeometry& a, const PolyGeometry& b, Manifold& manifold, SeparatingAxis* cache) {
+    sf::Vector2f offset = b.centroid - a.centroid;
+    float reach = a.radius + b.radius;
+    if (dot(offset, offset) > reach * reach) {
+        return false;
+    }
+    bool useGJK = narrowphase == Narrowphase::gjk ||
+                  (narrowphase == Narrowphase::automatic && a.vertices.size() + b.vertices.size() >= gjk_min_vertices);
+    return useGJK ? GJK(a, b, manifold) : SAT(a, b, manifold, cache);
+}
+
+std::vector<std::pair<int, int>> pieceStack;
+PolyGeometry pieceScratch[2];
+
+// walks both piece hierarchies together and tests the pieces whose bounds overlap; the deepest piece contact
+// becomes the pair's manifold, and the separating axis cache only applies between two single-piece polygons
+bool collideBodies(const BodyGeometry& a, const BodyGeometry& b, Manifold& manifold, SeparatingAxis* cache) {
+    const std::vector<PieceNode>& hierarchyA = prototypes[a.prototype].hierarchy;
+    const std::vector<PieceNode>& hierarchyB = prototypes[b.prototype].hierarchy;
+    if (hierarchyA.size() == 1 && hierarchyB.size() == 1) {
+        return collide(bodyPiece(a, 0, pieceScratch[0]), bodyPiece(b, 0, pieceScratch[1]), manifold, cache);
+    }
+    // a single piece has no node bounds of its own, its body bounds stand in for the root
+    auto nodeBox = [](const BodyGeometry& body, int node) {
+        if (!body.nodeBounds.empty()) return body.nodeBounds[node];
+        const sf::FloatRect& r = body.bounds;
+        return AABB{{r.left, r.top}, {r.left + r.width, r.top + r.height}};
+    };
+    bool hit = false;
+    Manifold piece;
+    pieceStack.clear();
+    pieceStack.emplace_back(0, 0);
+    while (!pieceStack.empty()) {
+        int nodeA = pieceStack.back().first;
+        int nodeB = pieceStack.back().second;
+        pieceStack.pop_back();
+        AABB boxA = nodeBox(a, nodeA);
+        AABB boxB = nodeBox(b, nodeB);
+        if (!boxA.overlaps(boxB)) continue;
+        const PieceNode& x = hierarchyA[nodeA];
+        const PieceNode& y = hierarchyB[nodeB];
+        if (x.isLeaf() && y.isLeaf()) {
+            const PolyGeometry& pieceA = bodyPiece(a, x.piece, pieceScratch[0]);
+            const PolyGeometry& pieceB = bodyPiece(b, y.piece, pieceScratch[1]);
+            if (collide(pieceA, pieceB, piece, nullptr) && (!hit || piece.depth > manifold.depth)) {
+                manifold = piece;
+                hit = true;
+            }
+        } else if (y.isLeaf() || (!x.isLeaf() && boxA.perimeter() >= boxB.perimeter())) {
+            pieceStack.emplace_back(x.child1, nodeB);
+            pieceStack.emplace_back(x.child2, nodeB);
+        } else {
+            pieceStack.emplace_back(nodeA, y.child1);
+            pieceStack.emplace_back(nodeA, y.child2);
+        }
+    }
+    return hit;
+}
+
+std::vector<std::pair<unsigned int, unsigned int>> contactPairs;
+std::vector<Manifold> contacts;
+// separating axis cache, kept parallel to candidatePairs
+std::vector<SeparatingAxis> candidateAxes;
+
+unsigned long long statsSteps{0};
+unsigned long long statsCandidatePairs{0};
+unsigned long long statsSatTests{0};
+unsigned long long statsGjkTests{0};
+unsigned long long statsCacheLookups{0};
+unsigned long long statsCacheHits{0};
+
 void resizeVectors(unsigned int size) {
     polys.resize(size);
-    boundingBoxEntity.resize(size);
+    polyProxy.assign(size, null_node);
+    bodyType.assign(size, BodyType::staticBody);
+    movers.clear();
+    worldDirty = true;
+    prototypes.clear();
+    prototypeIds.clear();
+    polyGeometry.assign(size, BodyGeometry());
     boundingBoxValues.resize(size);
+    aabbHit.assign(size, 0);
+    satHit.assign(size, 0);
+    staticAabbHit.assign(size, 0);
+    staticSatHit.assign(size, 0);
+    staticPairHolds.assign(size, 0);
+    changedPolys.clear();
+    changedMark.assign(size, 0);
+    changedAll = true;
+    previousPolys.resize(size);
+    previousBounds.resize(size);
     rectSizes.resize(size);
     rotation_speed.resize(size);
 }
@@ -164,21 +1451,27 @@ bool readFromAvailableText() {
         settings >> polysCount;
         resizeVectors(polysCount);
         int polySize;
-        sf::Vector2f pos, p;
+        sf::Vector2f pos;
+        std::vector<sf::Vector2f> points;
         for (unsigned int i = 0; i < polysCount; ++i) {
             settings >> polySize;
-            polys[i].setPointCount(polySize);
+            points.resize(polySize);
             for (unsigned int j = 0; j < polySize; ++j) {
-                settings >> p.x >> p.y;
-                polys[i].setPoint(j, sf::Vector2f{p});
+                settings >> points[j].x >> points[j].y;
+            }
+            Outline kind = setPolygon(i, points);
+            const PolyShape& shape = prototypes[polys[i].prototype];
+            if (kind == Outline::decomposed) {
+                std::cout << "polygon " << i << " is concave, split into " << shape.pieces.size() << " convex pieces\n";
+            } else if (kind == Outline::hull) {
+                std::cout << "polygon " << i << " is not a simple polygon, using its convex hull ("
+                          << polySize << " -> " << shape.outline.size() << " points)\n";
             }
             settings >> pos.x >> pos.y;
             polys[i].setPosition(pos);
-            polys[i].setFillColor(sf::Color::White);
-            polys[i].setOutlineThickness(3.f);
-            polys[i].setOutlineColor(sf::Color::Red);
             // rotation speed
         }
+        std::cout << polysCount << " polygons share " << prototypes.size() << " prototypes\n";
         settings.close();
         return true;
     } else {
@@ -214,6 +1507,14 @@ void pressEvents(sf::RenderWindow& window, const sf::Event& event) {
             break;
         case sf::Keyboard::Space:
             spaceButtonFlag = !spaceButtonFlag;
+            worldDirty = true;
+            break;
+        case sf::Keyboard::P:
+            pushApartFlag = !pushApartFlag;
+            break;
+        case sf::Keyboard::B:
+            collisionStatsFlag = !collisionStatsFlag;
+            statsSteps = statsCandidatePairs = statsSatTests = statsGjkTests = statsCacheLookups = statsCacheHits = 0;
             break;
         default:
             // nothing
@@ -267,7 +1568,74 @@ void handleInput(sf::RenderWindow& window) {
     }
 }
 
-void update(const sf::Time& elapsed, sf::RenderWindow& window) {
+AABB tightBox(unsigned int i) {
+    const sf::FloatRect& r = boundingBoxValues[i];
+    return {{r.left, r.top}, {r.left + r.width, r.top + r.height}};
+}
+
+const AABB& proxyBox(unsigned int i) {
+    return (bodyType[i] == BodyType::staticBody ? staticTree : tree).nodes[polyProxy[i]].box;
+}
+
+void updateBoundingBox(unsigned int i) {
+    boundingBoxValues[i] = polyGeometry[i].bounds;
+}
+
+// polys[0] is driven by input; the rest hold still unless space is rotating them
+void classifyBodies() {
+    movers.clear();
+    for (unsigned int i = 0; i < polysCount; ++i) {
+        bodyType[i] = i == 0 ? BodyType::dynamic : spaceButtonFlag ? BodyType::kinematic : BodyType::staticBody;
+        if (bodyType[i] != BodyType::staticBody) {
+            movers.push_back(i);
+        }
+    }
+}
+
+// runs when the body types change: puts every polygon back in the tree for its type and forgets all pairs
+void rebuildWorld() {
+    classifyBodies();
+    tree = AABBTree();
+    staticTree = AABBTree();
+    candidatePairs.clear();
+    candidateKeys.clear();
+    candidateAxes.clear();
+    // refreshGeometry below frees the pieces of every static that was held
+    staticPairHolds.assign(polysCount, 0);
+    aabbHit.assign(polysCount, 0);
+    satHit.assign(polysCount, 0);
+    touched.clear();
+    for (unsigned int i = 0; i < polysCount; ++i) {
+        refreshGeometry(i);
+        updateBoundingBox(i);
+        if (bodyType[i] == BodyType::staticBody) {
+            polyProxy[i] = staticTree.createProxy(tightBox(i), i, 0.f);
+        } else {
+            polyProxy[i] = tree.createProxy(tightBox(i), i);
+        }
+    }
+
+    staticAabbHit.assign(polysCount, 0);
+    staticSatHit.assign(polysCount, 0);
+    Manifold manifold;
+    for (unsigned int i = 0; i < polysCount; ++i) {
+        if (bodyType[i] != BodyType::staticBody) continue;
+        staticTree.query(staticTree.nodes[polyProxy[i]].box, [i, &manifold](unsigned int j) {
+            if (j <= i || !boundingBoxValues[i].intersects(boundingBoxValues[j])) return;
+            staticAabbHit[i] = staticAabbHit[j] = 1;
+            if (collideBodies(polyGeometry[i], polyGeometry[j], manifold, nullptr)) {
+                staticSatHit[i] = staticSatHit[j] = 1;
+            }
+        });
+    }
+    // a polygon that just stopped moving must not keep blending from its last step
+    previousPolys = polys;
+    previousBounds = boundingBoxValues;
+    worldDirty = false;
+    changedAll = true;
+}
+
+void update(const sf::Time& elapsed) {
     float delta = elapsed.asSeconds();
 
     sf::Vector2f dir;
@@ -295,84 +1663,494 @@ void update(const sf::Time& elapsed, sf::RenderWindow& window) {
         polys[0].setPosition(polys[0].getPosition().x, window_h);
     }
 
-    float minX, minY, maxX, maxY;
-    sf::Vector2f p;
-    for(unsigned int i = 0; i < polysCount; ++i) {
-        // rectangles
+    // only movers can have changed; every other polygon keeps its geometry, bounds and tree node
+    moveBuffer.clear();
+    bool rebuilt = worldDirty;
+    if (worldDirty) {
+        rebuildWorld();
+    }
+    for (unsigned int m : movers) {
         if (spaceButtonFlag) {
-            polys[i].rotate(i * 0.25f + 0.25f);
-        }
-        polys[i].setFillColor(sf::Color::White);
-        polys[i].setOutlineThickness(3.f);
-        polys[i].setOutlineColor(sf::Color::Red);
-
-        p = polys[i].getTransform().transformPoint(polys[i].getPoint(0));
-        minX = maxX = p.x;
-        minY = maxY = p.y;
-
-        for (unsigned int j = 1; j < polys[i].getPointCount(); ++j) {
-            p = polys[i].getTransform().transformPoint(polys[i].getPoint(j));
-            minX = std::min(minX, p.x);
-            maxX = std::max(maxX, p.x);
-            minY = std::min(minY, p.y);
-            maxY = std::max(maxY, p.y);
-        }
-
-        // bounding boxes
-        boundingBoxValues[i] = sf::FloatRect(minX, minY, maxX - minX, maxY - minY);
-        boundingBoxEntity[i].setSize(sf::Vector2f(boundingBoxValues[i].width, boundingBoxValues[i].height));
-        boundingBoxEntity[i].setPosition(boundingBoxValues[i].left, boundingBoxValues[i].top); 
-        boundingBoxEntity[i].setFillColor(sf::Color::Transparent);
-        boundingBoxEntity[i].setOutlineThickness(1.0f);
-        boundingBoxEntity[i].setOutlineColor(sf::Color::White);
-    }
-
-    for(unsigned int i = 0; i < polysCount; ++i) {
-        for(unsigned int j = i+1; j < polysCount; ++j) {
-            if(boundingBoxValues[i].intersects(boundingBoxValues[j])) {  
-                polys[i].setFillColor(sf::Color::Green);
-                polys[j].setFillColor(sf::Color::Green);
+            polys[m].rotate(m * 0.25f + 0.25f);
+        }
+        bool reinserted = false;
+        if (refreshGeometry(m)) {
+            updateBoundingBox(m);
+            markChanged(m);
+            reinserted = tree.moveProxy(polyProxy[m], tightBox(m));
+        }
+        // only polygons whose box left its fat box look for new partners, in both trees
+        if (reinserted || rebuilt) {
+            moveBuffer.push_back(m);
+        }
+    }
+    for (unsigned int m : moveBuffer) {
+        auto addPair = [m](unsigned int other) {
+            if (other != m && candidateKeys.insert(pairKey(m, other)).second) {
+                candidatePairs.emplace_back(std::min(m, other), std::max(m, other));
+                candidateAxes.emplace_back();
+                holdStaticPieces(other);
+            }
+        };
+        tree.query(tree.nodes[polyProxy[m]].box, addPair);
+        staticTree.query(tree.nodes[polyProxy[m]].box, addPair);
+    }
+    // and pairs whose fat boxes came apart are dropped
+    for (unsigned int k = 0; k < candidatePairs.size();) {
+        unsigned int a = candidatePairs[k].first;
+        unsigned int b = candidatePairs[k].second;
+        if (proxyBox(a).overlaps(proxyBox(b))) {
+            ++k;
+        } else {
+            candidateKeys.erase(pairKey(a, b));
+            candidatePairs[k] = candidatePairs.back();
+            candidatePairs.pop_back();
+            candidateAxes[k] = candidateAxes.back();
+            candidateAxes.pop_back();
+            releaseStaticPieces(a);
+            releaseStaticPieces(b);
+        }
+    }
+
+    // only last step's flagged polygons need resetting
+    for (unsigned int i : touched) {
+        aabbHit[i] = satHit[i] = 0;
+        markChanged(i);
+    }
+    touched.clear();
+    contactPairs.clear();
+    contacts.clear();
+    Manifold manifold;
+    unsigned long long satTestsBefore = satTests;
+    unsigned long long gjkTestsBefore = gjkTests;
+    unsigned long long satCacheLookupsBefore = satCacheLookups;
+    unsigned long long satCacheHitsBefore = satCacheHits;
+    for (unsigned int k = 0; k < candidatePairs.size(); ++k) {
+        const auto& pair = candidatePairs[k];
+        unsigned int i = pair.first;
+        unsigned int j = pair.second;
+        if (!boundingBoxValues[i].intersects(boundingBoxValues[j])) continue;
+        if (!aabbHit[i]) {
+            touched.push_back(i);
+            markChanged(i);
+        }
+        if (!aabbHit[j]) {
+            touched.push_back(j);
+            markChanged(j);
+        }
+        aabbHit[i] = aabbHit[j] = 1;
+        if (collideBodies(polyGeometry[i], polyGeometry[j], manifold, &candidateAxes[k])) {
+            satHit[i] = satHit[j] = 1;
+            contactPairs.push_back(pair);
+            contacts.push_back(manifold);
+        }
+    }
+
+    // with P toggled on, dynamic polygons are moved out along the normal, splitting the depth when both are dynamic
+    if (pushApartFlag) {
+        for (unsigned int k = 0; k < contacts.size(); ++k) {
+            unsigned int a = contactPairs[k].first;
+            unsigned int b = contactPairs[k].second;
+            bool moveA = bodyType[a] == BodyType::dynamic;
+            bool moveB = bodyType[b] == BodyType::dynamic;
+            float share = moveA && moveB ? 0.5f : 1.f;
+            sf::Vector2f push = contacts[k].normal * (contacts[k].depth * share);
+            if (moveA) {
+                polys[a].move(-push);
+                markChanged(a);
             }
-            if (SAT(polys[i], polys[j])) {
-                polys[i].setFillColor(sf::Color::Blue);
-                polys[j].setFillColor(sf::Color::Blue);
+            if (moveB) {
+                polys[b].move(push);
+                markChanged(b);
             }
         }
-    }  
+    }
+
+    if (collisionStatsFlag) {
+        statsSteps++;
+        statsCandidatePairs += candidatePairs.size();
+        statsSatTests += satTests - satTestsBefore;
+        statsGjkTests += gjkTests - gjkTestsBefore;
+        statsCacheLookups += satCacheLookups - satCacheLookupsBefore;
+        statsCacheHits += satCacheHits - satCacheHitsBefore;
+        // report about once a second of simulated time
+        if (statsSteps * delta >= 1.f) {
+            std::cout << "polygons: " << polysCount
+                      << " | candidate pairs/step: " << statsCandidatePairs / statsSteps
+                      << " | SAT tests/step: " << statsSatTests / statsSteps
+                      << " | GJK tests/step: " << statsGjkTests / statsSteps
+                      << " | axis cache hits/lookups: " << statsCacheHits << "/" << statsCacheLookups
+                      << " (" << (statsCacheLookups ? 100.f * statsCacheHits / statsCacheLookups : 0.f) << "%)\n";
+            statsSteps = statsCandidatePairs = statsSatTests = statsGjkTests = statsCacheLookups = statsCacheHits = 0;
+        }
+    }
+}
+
+// the outline sf::RectangleShape would draw around r as four one pixel lines, each through the middle of the
+// pixel row or column just outside r
+constexpr unsigned int frame_vertices{8};
+
+void setFrame(sf::Vertex* v, const sf::FloatRect& r) {
+    float l = r.left - 0.5f, t = r.top - 0.5f, rr = r.left + r.width + 0.5f, b = r.top + r.height + 0.5f;
+    v[0].position = {l, t};
+    v[1].position = v[2].position = {rr, t};
+    v[3].position = v[4].position = {rr, b};
+    v[5].position = v[6].position = {l, b};
+    v[7].position = {l, t};
+}
+
+// a polygon overlapping anything under SAT is blue, otherwise green if only its box overlaps
+sf::Color polyColor(unsigned int i) {
+    if (satHit[i] || staticSatHit[i]) return sf::Color::Blue;
+    if (aabbHit[i] || staticAabbHit[i]) return sf::Color::Green;
+    return sf::Color::White;
 }
 
-void render(sf::RenderWindow& window) {
+// the sync stage between update() and drawing: it runs once per rendered frame however many fixed steps ran,
+// and reads only the simulation's own state (placements, bounds and hit flags) of the polygons it marked changed
+// every polygon's fill and border pre-transformed into one triangle list and its bounding box into one line list,
+// so the scene is two draw calls; the triangles come from the prototypes once, and afterwards a polygon's slice is
+// only rewritten when it moves (positions) or changes color (fill colors), which for a still scene is nothing at all
+struct PolygonBatch {
+    struct Slice {
+        unsigned int prototype{0};
+        unsigned int fill{0};   // first vertex of each part
+        unsigned int border{0};
+        sf::Vector2f position;
+        float rotation{0.f};
+        sf::Color color;
+        sf::FloatRect bounds;
+    };
+
+    sf::VertexArray vertices{sf::Triangles};
+    sf::VertexArray frames{sf::Lines}; // frame_vertices per polygon, in polygon order
+    std::vector<Slice> slices;
+
+    void build() {
+        slices.assign(polysCount, Slice());
+        unsigned int count = 0;
+        for (unsigned int i = 0; i < polysCount; ++i) {
+            const PolyShape& shape = prototypes[polys[i].prototype];
+            Slice& slice = slices[i];
+            slice.prototype = polys[i].prototype;
+            slice.fill = count;
+            slice.border = slice.fill + shape.fill.size();
+            count = slice.border + shape.border.size();
+        }
+        vertices.resize(count);
+        frames.resize(polysCount * frame_vertices);
+        for (unsigned int i = 0; i < polysCount; ++i) {
+            const Slice& slice = slices[i];
+            unsigned int end = slice.border + prototypes[slice.prototype].border.size();
+            for (unsigned int v = slice.border; v < end; ++v) vertices[v].color = sf::Color::Red;
+            for (unsigned int v = 0; v < frame_vertices; ++v) frames[i * frame_vertices + v].color = sf::Color::White;
+            writePlacement(i, polys[i]);
+            writeColor(i);
+            writeBounds(i, boundingBoxValues[i]);
+        }
+    }
+
+    void writePlacement(unsigned int i, const PolyInstance& placement) {
+        const PolyShape& shape = prototypes[placement.prototype];
+        Slice& slice = slices[i];
+        slice.position = placement.getPosition();
+        slice.rotation = placement.getRotation();
+        sf::Transform transform = placement.getTransform();
+        for (unsigned int v = 0; v < shape.fill.size(); ++v) {
+            vertices[slice.fill + v].position = transform.transformPoint(shape.fill[v]);
+        }
+        for (unsigned int v = 0; v < shape.border.size(); ++v) {
+            vertices[slice.border + v].position = transform.transformPoint(shape.border[v]);
+        }
+    }
+
+    void writeColor(unsigned int i) {
+        Slice& slice = slices[i];
+        slice.color = polyColor(i);
+        for (unsigned int v = slice.fill; v < slice.border; ++v) vertices[v].color = slice.color;
+    }
+
+    void writeBounds(unsigned int i, const sf::FloatRect& bounds) {
+        Slice& slice = slices[i];
+        slice.bounds = bounds;
+        setFrame(&frames[i * frame_vertices], slice.bounds);
+    }
+
+    // movers are drawn alpha of the way from their previous step, turning the short way round
+    void syncPoly(unsigned int i, float alpha) {
+        const Slice& slice = slices[i];
+        PolyInstance placement = polys[i];
+        sf::FloatRect bounds = boundingBoxValues[i];
+        if (bodyType[i] != BodyType::staticBody && alpha < 1.f) {
+            auto blend = [alpha](float from, float to) { return from + (to - from) * alpha; };
+            const PolyInstance& from = previousPolys[i];
+            float turn = polys[i].getRotation() - from.getRotation();
+            turn -= turn > 180.f ? 360.f : turn < -180.f ? -360.f : 0.f;
+            placement.setPosition(blend(from.getPosition().x, placement.getPosition().x),
+                                  blend(from.getPosition().y, placement.getPosition().y));
+            placement.setRotation(from.getRotation() + turn * alpha);
+            const sf::FloatRect& fromBounds = previousBounds[i];
+            bounds = sf::FloatRect(blend(fromBounds.left, bounds.left), blend(fromBounds.top, bounds.top),
+                                   blend(fromBounds.width, bounds.width), blend(fromBounds.height, bounds.height));
+        }
+        if (slice.position != placement.getPosition() || slice.rotation != placement.getRotation()) {
+            writePlacement(i, placement);
+        }
+        if (slice.color != polyColor(i)) writeColor(i);
+        if (slice.bounds != bounds) writeBounds(i, bounds);
+    }
+
+    // after a rebuild every polygon is compared, and a new scene (another polygon count or prototype) lays the
+    // batch out again; otherwise only the changed polygons are, plus the movers, whose blend changes every frame
+    void sync(float alpha) {
+        if (changedAll) {
+            bool sameLayout = slices.size() == polysCount;
+            for (unsigned int i = 0; sameLayout && i < polysCount; ++i) {
+                sameLayout = slices[i].prototype == polys[i].prototype;
+            }
+            if (!sameLayout) {
+                build();
+            }
+            for (unsigned int i = 0; i < polysCount; ++i) syncPoly(i, alpha);
+        } else {
+            for (unsigned int i : changedPolys) syncPoly(i, alpha);
+            for (unsigned int m : movers) {
+                if (!changedMark[m]) syncPoly(m, alpha);
+            }
+        }
+        for (unsigned int i : changedPolys) changedMark[i] = 0;
+        changedPolys.clear();
+        changedAll = false;
+    }
+};
+
+PolygonBatch polygonBatch;
+
+void render(sf::RenderWindow& window, float alpha) {
     window.clear(sf::Color::Black);
+    polygonBatch.sync(alpha);
+    window.draw(polygonBatch.vertices);
+    window.draw(polygonBatch.frames);
+    window.display();
+}
+
+float randomFloat(float lo, float hi) {
+    return lo + (hi - lo) * (rand() / static_cast<float>(RAND_MAX));
+}
+
+// count random convex polygons with the given number of vertices, spaced so that with the default spacing
+// many bounding boxes overlap
+void generateScene(unsigned int count, unsigned int vertices, float radius = 40.f, float spacing = 1.5f) {
+    polysCount = count;
+    resizeVectors(polysCount);
+    float side = std::sqrt(static_cast<float>(count)) * radius * spacing;
+    std::vector<float> angles(vertices);
     for (unsigned int i = 0; i < polysCount; ++i) {
-        window.draw(polys[i]);
-        window.draw(boundingBoxEntity[i]);
+        // jittered angles on a circle give a convex ring without near-duplicate vertices
+        for (unsigned int j = 0; j < vertices; ++j) {
+            angles[j] = (j + randomFloat(0.f, 0.8f)) * 2.f * pi / vertices;
+        }
+        std::vector<sf::Vector2f> points(vertices);
+        for (unsigned int j = 0; j < vertices; ++j) {
+            points[j] = sf::Vector2f(std::cos(angles[j]), std::sin(angles[j])) * radius;
+        }
+        setPolygon(i, points);
+        polys[i].setPosition(randomFloat(0.f, side), randomFloat(0.f, side));
+        polys[i].setRotation(randomFloat(0.f, 360.f));
     }
-    window.display();
+    window_w = window_h = side;
 }
 
-int main () {
-    srand(time(NULL));
+// heap and vector bytes each polygon instance holds for collision (placement and world geometry) and for drawing
+// (its slice of the batch); the shared prototypes are left out
+double collisionBytesPerPoly() {
+    std::size_t bytes = polys.capacity() * sizeof(PolyInstance) + polyGeometry.capacity() * sizeof(BodyGeometry);
+    for (const BodyGeometry& body : polyGeometry) {
+        bytes += body.pieces.capacity() * sizeof(PolyGeometry) + body.nodeBounds.capacity() * sizeof(AABB);
+        for (const PolyGeometry& piece : body.pieces) {
+            bytes += (piece.vertices.capacity() + piece.rotatedNormals.capacity()) * sizeof(sf::Vector2f);
+            bytes += piece.supportHint.capacity() * sizeof(unsigned int);
+        }
+    }
+    return polysCount ? bytes / static_cast<double>(polysCount) : 0.0;
+}
+
+double batchBytesPerPoly() {
+    std::size_t bytes = (polygonBatch.vertices.getVertexCount() + polygonBatch.frames.getVertexCount()) * sizeof(sf::Vertex);
+    bytes += polygonBatch.slices.capacity() * sizeof(PolygonBatch::Slice);
+    return polysCount ? bytes / static_cast<double>(polysCount) : 0.0;
+}
+
+// steps a generated world headless with polys[0] sweeping right, to show the per-step cost follows the movers
+void benchmarkWorld(unsigned int count, unsigned int steps) {
+    srand(179);
+    generateScene(count, 6, 10.f, 4.f);
+    polys[0].setPosition(0.f, window_h / 2.f);
+    speed = window_w / (steps * fixed_update_time.asSeconds());
+    directionFlags[static_cast<unsigned int>(Direction::right)] = true;
+
+    sf::Clock clock;
+    update(fixed_update_time);
+    double buildSeconds = clock.restart().asSeconds();
+    unsigned long long pairs = 0;
+    for (unsigned int step = 0; step < steps; ++step) {
+        update(fixed_update_time);
+        pairs += candidatePairs.size();
+    }
+    double seconds = clock.getElapsedTime().asSeconds();
+    directionFlags[static_cast<unsigned int>(Direction::right)] = false;
+    polygonBatch.build();
+
+    std::cout << std::setw(10) << count << std::setw(8) << movers.size()
+              << std::setw(12) << std::fixed << std::setprecision(2) << buildSeconds * 1e3
+              << std::setw(14) << std::setprecision(2) << seconds * 1e6 / steps
+              << std::setw(14) << std::setprecision(1) << static_cast<double>(pairs) / steps
+              << std::setw(16) << std::setprecision(0) << collisionBytesPerPoly()
+              << std::setw(14) << batchBytesPerPoly()
+              << std::setw(14) << collisionBytesPerPoly() + batchBytesPerPoly() << "\n";
+}
+
+// runs one narrowphase over every pair, repeating for about a quarter of a second
+double timeNarrowphase(Narrowphase policy, const std::vector<std::pair<unsigned int, unsigned int>>& pairs, std::vector<unsigned char>& hits) {
+    narrowphase = policy;
+    Manifold manifold;
+    unsigned int rounds = 0;
+    double seconds = 0.0;
+    sf::Clock clock;
+    while (seconds < 0.25) {
+        for (unsigned int k = 0; k < pairs.size(); ++k) {
+            hits[k] = collideBodies(polyGeometry[pairs[k].first], polyGeometry[pairs[k].second], manifold, nullptr);
+        }
+        ++rounds;
+        seconds = clock.getElapsedTime().asSeconds();
+    }
+    return pairs.empty() ? 0.0 : seconds * 1e9 / (static_cast<double>(rounds) * pairs.size());
+}
+
+void benchmarkScene(const std::string& name) {
+    // every polygon keeps its world pieces here, so the timings are the pair tests alone
+    bodyType.assign(polysCount, BodyType::dynamic);
+    unsigned int totalVertices = 0;
+    for (unsigned int i = 0; i < polysCount; ++i) {
+        refreshGeometry(i);
+        for (const PolyGeometry& piece : polyGeometry[i].pieces) {
+            totalVertices += piece.vertices.size();
+        }
+    }
+    std::vector<std::pair<unsigned int, unsigned int>> pairs;
+    for (unsigned int i = 0; i < polysCount; ++i) {
+        for (unsigned int j = i+1; j < polysCount; ++j) {
+            if (polyGeometry[i].bounds.intersects(polyGeometry[j].bounds)) {
+                pairs.emplace_back(i, j);
+            }
+        }
+    }
+
+    std::vector<unsigned char> satHits(pairs.size()), gjkHits(pairs.size());
+    double satTime = timeNarrowphase(Narrowphase::sat, pairs, satHits);
+    double gjkTime = timeNarrowphase(Narrowphase::gjk, pairs, gjkHits);
+    narrowphase = Narrowphase::automatic;
+    unsigned int overlapping = std::count(satHits.begin(), satHits.end(), 1);
+    unsigned int disagreements = 0;
+    for (unsigned int k = 0; k < pairs.size(); ++k) {
+        disagreements += satHits[k] != gjkHits[k];
+    }
+
+    std::cout << std::setw(14) << name
+              << std::setw(12) << std::fixed << std::setprecision(1) << (polysCount ? totalVertices / static_cast<float>(polysCount) : 0.f)
+              << std::setw(8) << pairs.size()
+              << std::setw(8) << overlapping
+              << std::setw(14) << std::setprecision(1) << satTime
+              << std::setw(14) << gjkTime
+              << std::setw(10) << disagreements << "\n";
+}
+
+// hw02.2 --bench                        compares SAT and GJK on hw02.2.txt and on generated scenes of 4 to 1024 vertices
+// hw02.2 --world [steps]                steps 1k to 100k static polygons with one mover
+// hw02.2 --narrowphase <auto|sat|gjk>   runs the window with the narrowphase forced one way
+int runWindowed();
+
+int printUsage() {
+    std::cout << "usage: hw02.2 [--bench | --world [steps] | --narrowphase <auto|sat|gjk>]\n";
+    return 1;
+}
+
+// whole positive numbers only; stoul would throw on "abc" and take "-5" or "12x"
+bool parseSteps(const char* text, unsigned int& steps) {
+    if (*text < '0' || *text > '9') return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long value = std::strtoul(text, &end, 10);
+    if (errno != 0 || *end != '\0' || value == 0 || value > std::numeric_limits<unsigned int>::max()) return false;
+    steps = static_cast<unsigned int>(value);
+    return true;
+}
+
+int runFromCommandLine(int argc, char* argv[]) {
+    std::string mode = argv[1];
+    if (mode == "--bench") {
+        std::cout << std::setw(14) << "scene" << std::setw(12) << "verts/poly" << std::setw(8) << "pairs" << std::setw(8) << "hits"
+                  << std::setw(14) << "SAT ns/pair" << std::setw(14) << "GJK ns/pair" << std::setw(10) << "disagree" << "\n";
+        if (readFromAvailableText()) {
+            benchmarkScene("hw02.2.txt");
+        }
+        srand(179);
+        for (unsigned int vertices = 4; vertices <= 1024; vertices *= 2) {
+            generateScene(200, vertices);
+            benchmarkScene("random-" + std::to_string(vertices));
+        }
+        return 0;
+    }
+    if (mode == "--world") {
+        unsigned int steps = 600;
+        if (argc > 2 && !parseSteps(argv[2], steps)) return printUsage();
+        std::cout << std::setw(10) << "polygons" << std::setw(8) << "movers" << std::setw(12) << "build ms"
+                  << std::setw(14) << "us/step" << std::setw(14) << "pairs/step"
+                  << std::setw(16) << "collide B/poly" << std::setw(14) << "batch B/poly" << std::setw(14) << "total B/poly" << "\n";
+        for (unsigned int count = 1000; count <= 100000; count *= 10) {
+            benchmarkWorld(count, steps);
+        }
+        return 0;
+    }
+    if (mode == "--narrowphase" && argc > 2) {
+        std::string policy = argv[2];
+        narrowphase = policy == "sat" ? Narrowphase::sat : policy == "gjk" ? Narrowphase::gjk : Narrowphase::automatic;
+        initializeSettings();
+        return runWindowed();
+    }
+    return printUsage();
+}
+
+int runWindowed() {
     sf::RenderWindow window(sf::VideoMode(window_w, window_h), "HW02.2");
 	window.setFramerateLimit(fps_limit);
 
-    initializeSettings();
-    
+    FixedTimestep timestep(fixed_update_time, max_substeps);
     sf::Clock clock;
-    sf::Time timeSinceLastUpdate;
     while(window.isOpen()) {
-        sf::Time elapsed = clock.restart();
-        timeSinceLastUpdate += elapsed;
-
         handleInput(window);
-        while (timeSinceLastUpdate >= fixed_update_time) {
-            update(fixed_update_time, window);
-            timeSinceLastUpdate -= fixed_update_time;
+        // only the movers' state before the frame's last step is needed for blending
+        for (unsigned int steps = timestep.advance(clock.restart()); steps > 0; --steps) {
+            if (steps == 1) {
+                snapshotMovers();
+            }
+            update(fixed_update_time);
         }
-        render(window);
+        render(window, timestep.alpha());
     }
     return 0;
 }
 
+int main (int argc, char* argv[]) {
+    srand(time(NULL));
+    if (argc > 1) {
+        return runFromCommandLine(argc, argv);
+    }
+
+    initializeSettings();
+    return runWindowed();
+}
+
 /* unused; reference code from CS179.10 on my HW9 with wil
 sf::Vector2f SAT(const std::vector<sf::Vector2f>& a, const std::vector<sf::Vector2f>& b) {
     int aL = a.size();
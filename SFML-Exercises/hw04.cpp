@@ -4,6 +4,7 @@
 #include <fstream>
 #include <vector>
 #include <SFML/Graphics.hpp>
+#include "fixed_timestep.hpp"
 
 namespace utility {
     // in case the person compiling this does not have C++17 installed
@@ -20,6 +21,7 @@ namespace utility {
 constexpr unsigned int fps_limit{255};
 constexpr float epsilon{1e-6f};
 const sf::Time fixed_update_time = sf::seconds(1.f/fps_limit);
+constexpr unsigned int max_substeps{16};
 const sf::Vector2f zero_vector{0.f,0.f};
 constexpr float pi{std::acos(-1)};
 constexpr float deg_to_rad{pi/180.f};
@@ -282,16 +284,12 @@ int main () {
 
     initializeSettings();
     
+    FixedTimestep timestep(fixed_update_time, max_substeps);
     sf::Clock clock;
-    sf::Time timeSinceLastUpdate;
     while(window.isOpen()) {
-        sf::Time elapsed = clock.restart();
-        timeSinceLastUpdate += elapsed;
-
         handleInput(window);
-        while (timeSinceLastUpdate >= fixed_update_time) {
+        for (unsigned int steps = timestep.advance(clock.restart()); steps > 0; --steps) {
             update(fixed_update_time, window);
-            timeSinceLastUpdate -= fixed_update_time;
         }
         render(window);
     }
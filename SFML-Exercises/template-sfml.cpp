@@ -4,6 +4,7 @@
 #include <fstream>
 #include <vector>
 #include <SFML/Graphics.hpp>
+#include "fixed_timestep.hpp"
 
 namespace utility {
     // in case the person compiling this does not have C++17 installed
@@ -20,6 +21,7 @@ namespace utility {
 constexpr unsigned int fps_limit{255};
 constexpr float epsilon{1e-6f};
 const sf::Time fixed_update_time = sf::seconds(1.f/fps_limit);
+constexpr unsigned int max_substeps{16};
 const sf::Vector2f zero_vector{0.f,0.f};
 constexpr float pi{std::acos(-1)};
 constexpr float deg_to_rad{pi/180.f};
@@ -51,6 +53,9 @@ unsigned int window_h{default_vals::window_h};
 bool directionFlags[4] = {false, false, false, false};
 bool leftMouseButtonFlag = false;
 
+// state before the latest fixed step goes here, next to the current state;
+// render draws alpha of the way between the two
+
 bool readFromAvailableText() {
     std::string input;
     std::ifstream settings("collision.txt");
@@ -145,9 +150,10 @@ void update(const sf::Time& elapsed, sf::RenderWindow& window) {
     // update stuff here
 }
 
-void render(sf::RenderWindow& window) {
+// alpha in [0, 1) is how far the current frame is between the last two fixed steps
+void render(sf::RenderWindow& window, [[maybe_unused]] float alpha) {
     window.clear(sf::Color::Black);
-    // draw stuff here
+    // draw stuff here, each at previous + (current - previous) * alpha
     window.display();
 }
 
@@ -158,18 +164,18 @@ int main () {
 
     initializeSettings();
     
+    FixedTimestep timestep(fixed_update_time, max_substeps);
     sf::Clock clock;
-    sf::Time timeSinceLastUpdate;
     while(window.isOpen()) {
-        sf::Time elapsed = clock.restart();
-        timeSinceLastUpdate += elapsed;
-
         handleInput(window);
-        while (timeSinceLastUpdate >= fixed_update_time) {
+        for (unsigned int steps = timestep.advance(clock.restart()); steps > 0; --steps) {
+            // only the state before the frame's last step is needed for blending
+            if (steps == 1) {
+                // copy the current state into the previous one here
+            }
             update(fixed_update_time, window);
-            timeSinceLastUpdate -= fixed_update_time;
         }
-        render(window);
+        render(window, timestep.alpha());
     }
     return 0;
 }
\ No newline at end of file